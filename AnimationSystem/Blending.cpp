@@ -0,0 +1,205 @@
+#include "Blending.h"
+#include "FrameArena.h"
+#ifdef BLENDING_SSE
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+bool IsInHierarchy(Pose& pose, unsigned int parent, unsigned int search) {
+	if (search == parent) {
+		return true;
+	}
+	int p = pose.GetParent(search);
+	while (p >= 0) {
+		if (p == (int)parent) {
+			return true;
+		}
+		p = pose.GetParent(p);
+	}
+	return false;
+}
+
+void BuildBlendMask(Pose& pose, int blendRoot, float* outMask) {
+	unsigned int size = pose.Size();
+	for (unsigned int i = 0; i < size; ++i) {
+		int parent = pose.GetParent(i);
+		if (blendRoot < 0 || i == (unsigned int)blendRoot) {
+			outMask[i] = 1.0f;
+		}
+		else if (parent < (int)i) { // Parent is already done
+			outMask[i] = parent >= 0 ? outMask[parent] : 0.0f;
+		}
+		else {
+			outMask[i] = IsInHierarchy(pose, (unsigned int)blendRoot, i) ? 1.0f : 0.0f;
+		}
+	}
+}
+
+void BuildBlendMask(Pose& pose, int blendRoot, std::vector<float>& outMask) {
+	outMask.resize(pose.Size());
+	if (outMask.size() != 0) {
+		BuildBlendMask(pose, blendRoot, &outMask[0]);
+	}
+}
+
+namespace BlendingHelpers {
+	inline void BlendJoint(Transform& out, const Transform& a, const Transform& b, float t) {
+		if (t == 0.0f) {
+			out = a;
+		}
+		else {
+			out = Mix(a, b, t);
+		}
+	}
+}
+
+#ifdef BLENDING_SSE
+
+void BlendTransforms(Transform* out, const Transform* a, const Transform* b,
+	const float* weights, unsigned int count) {
+	static_assert(sizeof(Transform) == 10 * sizeof(float), "Transform must be tightly packed");
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 epsilon = _mm_set1_ps(QUAT_EPSILON);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		// Four transforms are 40 floats, positions and scales are lerped
+		// as one flat array with each joint's weight repeated ten times
+		float lanes[40];
+		for (unsigned int k = 0; k < 4; ++k) {
+			for (unsigned int f = 0; f < 10; ++f) {
+				lanes[k * 10 + f] = weights[i + k];
+			}
+		}
+		const float* fa = a[i].position.v;
+		const float* fb = b[i].position.v;
+		__m128 flat[10];
+		for (unsigned int r = 0; r < 10; ++r) {
+			__m128 va = _mm_loadu_ps(fa + r * 4);
+			__m128 vb = _mm_loadu_ps(fb + r * 4);
+			flat[r] = _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), _mm_loadu_ps(lanes + r * 4)));
+		}
+
+		// Rotations are transposed so each register holds one component
+		// of the four quaternions, then nlerped along the shortest path
+		__m128 ax = _mm_loadu_ps(a[i].rotation.v);
+		__m128 ay = _mm_loadu_ps(a[i + 1].rotation.v);
+		__m128 az = _mm_loadu_ps(a[i + 2].rotation.v);
+		__m128 aw = _mm_loadu_ps(a[i + 3].rotation.v);
+		_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+		__m128 bx = _mm_loadu_ps(b[i].rotation.v);
+		__m128 by = _mm_loadu_ps(b[i + 1].rotation.v);
+		__m128 bz = _mm_loadu_ps(b[i + 2].rotation.v);
+		__m128 bw = _mm_loadu_ps(b[i + 3].rotation.v);
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+		__m128 t = _mm_loadu_ps(&weights[i]);
+
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+			_mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), signBit);
+		bx = _mm_xor_ps(bx, flip);
+		by = _mm_xor_ps(by, flip);
+		bz = _mm_xor_ps(bz, flip);
+		bw = _mm_xor_ps(bw, flip);
+
+		__m128 rx = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), t));
+		__m128 ry = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), t));
+		__m128 rz = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), t));
+		__m128 rw = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), t));
+
+		// Normalize like Normalised, then keep a where the weight is 0
+		__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)),
+			_mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw)));
+		__m128 valid = _mm_cmpge_ps(lenSq, epsilon);
+		__m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(lenSq));
+		rx = _mm_and_ps(_mm_mul_ps(rx, invLen), valid);
+		ry = _mm_and_ps(_mm_mul_ps(ry, invLen), valid);
+		rz = _mm_and_ps(_mm_mul_ps(rz, invLen), valid);
+		rw = _mm_or_ps(_mm_and_ps(_mm_mul_ps(rw, invLen), valid),
+			_mm_andnot_ps(valid, one));
+		__m128 keep = _mm_cmpeq_ps(t, _mm_setzero_ps());
+		rx = _mm_or_ps(_mm_and_ps(keep, ax), _mm_andnot_ps(keep, rx));
+		ry = _mm_or_ps(_mm_and_ps(keep, ay), _mm_andnot_ps(keep, ry));
+		rz = _mm_or_ps(_mm_and_ps(keep, az), _mm_andnot_ps(keep, rz));
+		rw = _mm_or_ps(_mm_and_ps(keep, aw), _mm_andnot_ps(keep, rw));
+		_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+
+		float* fo = out[i].position.v;
+		for (unsigned int r = 0; r < 10; ++r) {
+			_mm_storeu_ps(fo + r * 4, flat[r]);
+		}
+		_mm_storeu_ps(out[i].rotation.v, rx);
+		_mm_storeu_ps(out[i + 1].rotation.v, ry);
+		_mm_storeu_ps(out[i + 2].rotation.v, rz);
+		_mm_storeu_ps(out[i + 3].rotation.v, rw);
+	}
+
+	for (; i < count; ++i) { // Leftovers
+		BlendingHelpers::BlendJoint(out[i], a[i], b[i], weights[i]);
+	}
+}
+
+#else
+
+void BlendTransforms(Transform* out, const Transform* a, const Transform* b,
+	const float* weights, unsigned int count) {
+	for (unsigned int i = 0; i < count; ++i) {
+		BlendingHelpers::BlendJoint(out[i], a[i], b[i], weights[i]);
+	}
+}
+
+#endif
+
+void BlendTransforms(Transform* out, const Transform* a, const Transform* b,
+	float t, unsigned int count) {
+	FrameArena& arena = FrameArena::GetThreadArena();
+	FrameArenaMarker marker = arena.GetMarker();
+	float* weights = arena.Allocate<float>(count);
+	for (unsigned int i = 0; i < count; ++i) {
+		weights[i] = t;
+	}
+	BlendTransforms(out, a, b, weights, count);
+	arena.Rewind(marker);
+}
+
+namespace BlendingHelpers {
+	void BlendPoses(Pose& output, Pose& a, Pose& b, const float* weights) {
+		unsigned int size = a.Size();
+		if (output.Size() != size) {
+			output = a;
+		}
+		BlendTransforms(output.GetLocalTransformData(), a.GetLocalTransformData(),
+			b.GetLocalTransformData(), weights, size);
+		for (unsigned int i = 0; i < size; ++i) {
+			if (weights[i] != 0.0f || &output != &a) {
+				output.MarkDirty(i);
+			}
+		}
+	}
+}
+
+void Blend(Pose& output, Pose& a, Pose& b, float t, int blendRoot) {
+	unsigned int size = a.Size();
+	FrameArena& arena = FrameArena::GetThreadArena();
+	FrameArenaMarker marker = arena.GetMarker();
+	float* weights = arena.Allocate<float>(size);
+	BuildBlendMask(a, blendRoot, weights);
+	for (unsigned int i = 0; i < size; ++i) {
+		weights[i] *= t;
+	}
+	BlendingHelpers::BlendPoses(output, a, b, weights);
+	arena.Rewind(marker);
+}
+
+void Blend(Pose& output, Pose& a, Pose& b, float t, const std::vector<float>& mask) {
+	unsigned int size = a.Size();
+	FrameArena& arena = FrameArena::GetThreadArena();
+	FrameArenaMarker marker = arena.GetMarker();
+	float* weights = arena.Allocate<float>(size);
+	for (unsigned int i = 0; i < size; ++i) {
+		weights[i] = i < mask.size() ? mask[i] * t : 0.0f;
+	}
+	BlendingHelpers::BlendPoses(output, a, b, weights);
+	arena.Rewind(marker);
+}
@@ -0,0 +1,32 @@
+#ifndef _H_BLENDING_
+#define _H_BLENDING_
+
+#include "Pose.h"
+#include <vector>
+
+// Define BLENDING_NO_SIMD to always use the scalar loops
+#if !defined(BLENDING_NO_SIMD) && (defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define BLENDING_SSE
+#endif
+
+bool IsInHierarchy(Pose& pose, unsigned int parent, unsigned int search);
+// 1 for the root and everything under it, 0 for the rest of the pose.
+// A negative root selects every joint.
+void BuildBlendMask(Pose& pose, int blendRoot, float* outMask);
+void BuildBlendMask(Pose& pose, int blendRoot, std::vector<float>& outMask);
+
+// out[i] = Mix(a[i], b[i], weights[i]) four joints at a time, a joint
+// with a weight of 0 is copied from a. out may be the same array as a or b.
+void BlendTransforms(Transform* out, const Transform* a, const Transform* b,
+	const float* weights, unsigned int count);
+void BlendTransforms(Transform* out, const Transform* a, const Transform* b,
+	float t, unsigned int count);
+
+// Blends whole poses of the same size. With a root only that subtree
+// moves towards b, the rest of the output is a. A mask holds a weight
+// per joint that t is scaled by, e.g. 1 for the upper body and 0 below.
+void Blend(Pose& output, Pose& a, Pose& b, float t, int blendRoot);
+void Blend(Pose& output, Pose& a, Pose& b, float t, const std::vector<float>& mask);
+
+#endif
@@ -1,4 +1,7 @@
 #include "Clip.h"
+#include "FrameArena.h"
+#include <cmath>
+#include <algorithm>
 
 Clip::Clip()
 {
@@ -6,13 +9,19 @@ Clip::Clip()
     mStartTime = 0.0f;
     mEndTime = 0.0f;
     mLooping = true;
+    mUniformInterpolation = false;
+    mInterpolation = Interpolation::Linear;
+    mBackend = SamplingBackend::Scalar;
 }
 
-float Clip::AdjustTimeToFitRange(float inTime)
+float Clip::AdjustTimeToFitRange(float inTime) const
 {
     if (mLooping) {
         float duration = mEndTime - mStartTime;
-        if (duration <= 0) { 0.0f; }
+        if (duration <= 0) { return 0.0f; }
+        if (inTime >= mStartTime && inTime < mEndTime) {
+            return inTime; // Already in range, no need for fmodf
+        }
         inTime = fmodf(inTime - mStartTime,
             mEndTime - mStartTime);
         if (inTime < 0.0f) {
@@ -38,33 +47,332 @@ unsigned int Clip::Size()
 
 float Clip::Sample(Pose& outPose, float inTime)
 {
-    if (GetDuration() == 0.0f) {
+    return Sample(outPose, inTime, mCursor);
+}
+
+float Clip::Sample(Pose& outPose, float inTime, ClipCursor& cursor) const
+{
+    if (mEndTime - mStartTime == 0.0f) {
+        return 0.0f;
+    }
+    inTime = AdjustTimeToFitRange(inTime);
+    SampleInRange(outPose, inTime, cursor);
+    return inTime;
+}
+
+float Clip::Sample(Transform* outLocals, unsigned int numJoints, float inTime)
+{
+    return Sample(outLocals, numJoints, inTime, mCursor);
+}
+
+float Clip::Sample(Transform* outLocals, unsigned int numJoints, float inTime, ClipCursor& cursor) const
+{
+    if (mEndTime - mStartTime == 0.0f) {
         return 0.0f;
     }
     inTime = AdjustTimeToFitRange(inTime);
+    SampleInRange(outLocals, numJoints, inTime, cursor);
+    return inTime;
+}
+
+int Clip::Sample(Pose& outPose, PlaybackTime& inOutTime, float deltaTime)
+{
+    return Sample(outPose, inOutTime, deltaTime, mCursor);
+}
+
+// Advances inOutTime by deltaTime and samples there. The time never leaves
+// the clip's range, so it does not lose precision however long the clip
+// plays. Returns how many times the clip wrapped, negative when playing
+// backwards.
+int Clip::Sample(Pose& outPose, PlaybackTime& inOutTime, float deltaTime, ClipCursor& cursor) const
+{
+    float sampleTime = 0.0f;
+    int wraps = 0;
+    if (AdvancePlaybackTime(inOutTime, deltaTime, sampleTime, wraps)) {
+        SampleInRange(outPose, sampleTime, cursor);
+    }
+    return wraps;
+}
+
+int Clip::Sample(Transform* outLocals, unsigned int numJoints, PlaybackTime& inOutTime, float deltaTime, ClipCursor& cursor) const
+{
+    float sampleTime = 0.0f;
+    int wraps = 0;
+    if (AdvancePlaybackTime(inOutTime, deltaTime, sampleTime, wraps)) {
+        SampleInRange(outLocals, numJoints, sampleTime, cursor);
+    }
+    return wraps;
+}
+
+// False if the clip has no duration and nothing should be sampled
+bool Clip::AdvancePlaybackTime(PlaybackTime& inOutTime, float deltaTime, float& outSampleTime, int& outWraps) const
+{
+    float duration = mEndTime - mStartTime;
+    if (duration == 0.0f) {
+        outWraps = 0;
+        return false;
+    }
+    int wraps = 0;
+    double time = inOutTime.mTime + deltaTime; // From mStartTime
+    if (mLooping) {
+        if (time < 0.0 || time >= duration) {
+            double loops = floor(time / duration);
+            time -= loops * duration;
+            wraps = (int)loops;
+            if (time >= duration) { // Rounding can land on the end
+                time -= duration;
+                ++wraps;
+            }
+            if (time < 0.0) {
+                time = 0.0;
+            }
+        }
+    }
+    else if (time < 0.0) {
+        time = 0.0;
+    }
+    else if (time > duration) {
+        time = duration;
+    }
+    inOutTime.mTime = time;
+    inOutTime.mLoops += wraps;
+    outSampleTime = mStartTime + (float)time;
+    if (outSampleTime >= mEndTime) {
+        // Just under the end can round up to it
+        outSampleTime = mLooping ? mStartTime : mEndTime;
+    }
+    outWraps = wraps;
+    return true;
+}
+
+void Clip::SampleInRange(Pose& outPose, float inTime, ClipCursor& cursor) const
+{
+    unsigned int numJoints = outPose.Size();
+    SampleInRange(outPose.GetLocalTransformData(), numJoints, inTime, cursor);
+    // Only the animated joints need their globals redone
     unsigned int size = mTracks.size();
     for (unsigned int i = 0; i < size; ++i) {
         unsigned int j = mTracks[i].GetId(); // Joint
-        Transform local = outPose.GetLocalTransform(j);
-        Transform animated = mTracks[i].Sample(
-            local, inTime, mLooping);
-        outPose.SetLocalTransform(j, animated);
+        if (j < numJoints) {
+            outPose.MarkDirty(j);
+        }
     }
-    return inTime;
 }
 
-TransformTrack& Clip::operator[](unsigned int joint)
+void Clip::SampleInRange(Transform* outLocals, unsigned int numJoints, float inTime, ClipCursor& cursor) const
 {
-    for (int i = 0, s = mTracks.size(); i < s; ++i) {
-        if (mTracks[i].GetId() == joint) {
-            return mTracks[i];
+    unsigned int size = mTracks.size();
+    if (cursor.mTracks.size() != size) {
+        cursor.mTracks.resize(size); // First use, or the clip was edited
+    }
+    if (mBackend == SamplingBackend::Simd) {
+        SampleTracksBatched(outLocals, numJoints, inTime, cursor);
+        return;
+    }
+    if (mUniformInterpolation) {
+        // Pick the specialized loop once, rather than per channel
+        switch (mInterpolation) {
+        case Interpolation::Constant:
+            SampleTracks<Interpolation::Constant>(outLocals, numJoints, inTime, cursor);
+            return;
+        case Interpolation::Linear:
+            SampleTracks<Interpolation::Linear>(outLocals, numJoints, inTime, cursor);
+            return;
+        case Interpolation::Cubic:
+            SampleTracks<Interpolation::Cubic>(outLocals, numJoints, inTime, cursor);
+            return;
+        }
+    }
+    // Animated channels are written straight into the pose
+    for (unsigned int i = 0; i < size; ++i) {
+        unsigned int j = mTracks[i].GetId(); // Joint
+        if (j < numJoints) {
+            mTracks[i].SampleInPlace(outLocals[j], inTime, mLooping, cursor.mTracks[i]);
+        }
+    }
+}
+
+void Clip::SampleBatch(Pose& restPose, const float* times, unsigned int count, std::vector<Pose>& outPoses) const
+{
+    outPoses.resize(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        outPoses[i] = restPose;
+    }
+    if (count == 0 || mEndTime - mStartTime == 0.0f) {
+        return;
+    }
+
+    // Scratch comes from this thread's arena and is handed back on return
+    FrameArena& arena = FrameArena::GetThreadArena();
+    FrameArenaMarker marker = arena.GetMarker();
+    float* clipTimes = arena.Allocate<float>(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        clipTimes[i] = AdjustTimeToFitRange(times[i]);
+    }
+
+    // One track at a time, so each track walks its keys once
+    Transform* locals = arena.Allocate<Transform>(count);
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        unsigned int j = mTracks[i].GetId(); // Joint
+        Transform local = restPose.GetLocalTransform(j);
+        for (unsigned int k = 0; k < count; ++k) {
+            locals[k] = local;
+        }
+        mTracks[i].SampleBatch(clipTimes, count, locals, mLooping);
+        for (unsigned int k = 0; k < count; ++k) {
+            outPoses[k].SetLocalTransform(j, locals[k]);
         }
     }
+    arena.Rewind(marker);
+}
+
+void Clip::SampleTracksBatched(Transform* outLocals, unsigned int numJoints, float inTime, ClipCursor& cursor) const
+{
+    unsigned int size = mTracks.size();
+    cursor.mRotationSegments.resize(size);
+    cursor.mRotationJoints.resize(size);
+    cursor.mRotations.resize(size);
+
+    // Everything but linear rotations is sampled as usual, those are
+    // gathered and interpolated together at the end
+    unsigned int numRotations = 0;
+    for (unsigned int i = 0; i < size; ++i) {
+        unsigned int j = mTracks[i].GetId(); // Joint
+        if (j >= numJoints) {
+            continue;
+        }
+        if (mTracks[i].SampleDeferred(outLocals[j], inTime,
+            mLooping, cursor.mRotationSegments[numRotations], cursor.mTracks[i])) {
+            cursor.mRotationJoints[numRotations++] = j;
+        }
+    }
+    if (numRotations == 0) {
+        return;
+    }
+
+    NlerpBatch(&cursor.mRotationSegments[0], numRotations, &cursor.mRotations[0]);
+    for (unsigned int i = 0; i < numRotations; ++i) {
+        outLocals[cursor.mRotationJoints[i]].rotation = cursor.mRotations[i];
+    }
+}
+
+template<Interpolation I>
+void Clip::SampleTracks(Transform* outLocals, unsigned int numJoints, float inTime, ClipCursor& cursor) const
+{
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        unsigned int j = mTracks[i].GetId(); // Joint
+        if (j < numJoints) {
+            mTracks[i].SampleInPlaceAs<I>(outLocals[j], inTime, mLooping, cursor.mTracks[i]);
+        }
+    }
+}
+
+TransformTrack& Clip::operator[](unsigned int joint)
+{
+    // The track may be edited, RecalculateInterpolation must run again
+    mUniformInterpolation = false;
+    int index = GetTrackIndex(joint);
+    if (index >= 0) {
+        return mTracks[index];
+    }
+    SetTrackIndex(joint, (int)mTracks.size());
     mTracks.push_back(TransformTrack());
     mTracks[mTracks.size() - 1].SetId(joint);
     return mTracks[mTracks.size() - 1];
 }
 
+int Clip::GetTrackIndex(unsigned int joint)
+{
+    if (joint < mTrackIndices.size()) {
+        return mTrackIndices[joint];
+    }
+    if (joint < CLIP_MAX_INDEXED_JOINT) {
+        return -1;
+    }
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        if (mTracks[i].GetId() == joint) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Ids too large for the table are left out of it, see GetTrackIndex
+void Clip::SetTrackIndex(unsigned int joint, int index)
+{
+    if (joint >= CLIP_MAX_INDEXED_JOINT) {
+        return;
+    }
+    if (joint >= mTrackIndices.size()) {
+        mTrackIndices.resize(joint + 1, -1);
+    }
+    mTrackIndices[joint] = index;
+}
+
+void Clip::RebuildTrackIndices()
+{
+    mTrackIndices.clear();
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        SetTrackIndex(mTracks[i].GetId(), (int)i);
+    }
+}
+
+// Stable sorts the tracks by one key per track
+void Clip::SortTracks(const std::vector<unsigned int>& keys)
+{
+    unsigned int size = mTracks.size();
+    std::vector<unsigned int> order(size);
+    for (unsigned int i = 0; i < size; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+        [&keys](unsigned int a, unsigned int b) {
+            return keys[a] < keys[b];
+        });
+    std::vector<TransformTrack> sorted(size);
+    for (unsigned int i = 0; i < size; ++i) {
+        sorted[i] = std::move(mTracks[order[i]]);
+    }
+    mTracks.swap(sorted);
+    RebuildTrackIndices();
+}
+
+void Clip::SortTracks()
+{
+    unsigned int size = mTracks.size();
+    std::vector<unsigned int> keys(size);
+    for (unsigned int i = 0; i < size; ++i) {
+        keys[i] = mTracks[i].GetId();
+    }
+    SortTracks(keys);
+}
+
+void Clip::SortTracks(Pose& hierarchy)
+{
+    SortTracks(); // Ties below keep joint id order
+
+    // Shallower joints first so a parent is always written before its
+    // children. Joints the pose does not have go last.
+    unsigned int numJoints = hierarchy.Size();
+    unsigned int size = mTracks.size();
+    std::vector<unsigned int> depths(size);
+    for (unsigned int i = 0; i < size; ++i) {
+        unsigned int joint = mTracks[i].GetId();
+        depths[i] = numJoints;
+        if (joint < numJoints) {
+            depths[i] = 0;
+            for (int p = hierarchy.GetParent(joint); p >= 0; p = hierarchy.GetParent(p)) {
+                ++depths[i];
+            }
+        }
+    }
+    SortTracks(depths);
+}
+
 void Clip::RecalculateDuration()
 {
     mStartTime = 0.0f;
@@ -88,14 +396,121 @@ void Clip::RecalculateDuration()
     }
 }
 
+void Clip::RecalculateInterpolation()
+{
+    mUniformInterpolation = true;
+    bool isSet = false;
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        Interpolation interpolation;
+        if (!mTracks[i].GetInterpolation(interpolation)) {
+            mUniformInterpolation = false;
+            return;
+        }
+        if (!mTracks[i].IsValid()) {
+            continue; // Nothing animated, nothing to sample
+        }
+        if (isSet && interpolation != mInterpolation) {
+            mUniformInterpolation = false;
+            return;
+        }
+        mInterpolation = interpolation;
+        isSet = true;
+    }
+}
+
+bool Clip::HasUniformInterpolation()
+{
+    return mUniformInterpolation;
+}
+
+SamplingBackend Clip::GetSamplingBackend()
+{
+    return mBackend;
+}
+
+void Clip::SetSamplingBackend(SamplingBackend backend)
+{
+    mBackend = backend;
+}
+
+unsigned int Clip::GetIndexLookupTableSize()
+{
+    unsigned int result = 0;
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        result += mTracks[i].GetIndexLookupTableSize();
+    }
+    return result;
+}
+
+void Clip::ClearIndexLookupTables()
+{
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        mTracks[i].ClearIndexLookupTables();
+    }
+}
+
+void Clip::SetCubicCoefficients(bool enabled)
+{
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        if (enabled) {
+            mTracks[i].UpdateCubicCoefficients();
+        }
+        else {
+            mTracks[i].ClearCubicCoefficients();
+        }
+    }
+}
+
+unsigned int Clip::UpdateSharedTimelines()
+{
+    unsigned int result = 0;
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        if (mTracks[i].UpdateSharedTimeline()) {
+            ++result;
+        }
+    }
+    return result;
+}
+
+unsigned int Clip::GetCubicCoefficientsSize()
+{
+    unsigned int result = 0;
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        result += mTracks[i].GetCubicCoefficientsSize();
+    }
+    return result;
+}
+
+unsigned int Clip::GetKeyMemorySize()
+{
+    unsigned int result = 0;
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        result += mTracks[i].GetKeyMemorySize();
+    }
+    return result;
+}
+
+void Clip::Quantize()
+{
+    unsigned int size = mTracks.size();
+    for (unsigned int i = 0; i < size; ++i) {
+        mTracks[i].Quantize();
+    }
+    mUniformInterpolation = false; // Quantized channels use the generic path
+}
+
 std::string& Clip::GetName() {
     return mName;
 }
-unsigned int Clip::GetIdAtIndex(unsigned int index) {
-    return mTracks[index].GetId();
-}
-unsigned int Clip::Size() {
-    return (unsigned int)mTracks.size();
+void Clip::SetName(const std::string& inNewName) {
+    mName = inNewName;
 }
 float Clip::GetDuration() {
     return mEndTime - mStartTime;
@@ -122,5 +537,55 @@ unsigned int Clip::GetIdAtIndex(unsigned int index)
 
 void Clip::SetIdAtIndex(unsigned int index, unsigned int id)
 {
-    return mTracks[index].SetId(id);
+    unsigned int oldId = mTracks[index].GetId();
+    if (GetTrackIndex(oldId) == (int)index) {
+        SetTrackIndex(oldId, -1);
+    }
+    mTracks[index].SetId(id);
+    SetTrackIndex(id, (int)index);
+}
+
+ClipError MeasureClipError(Clip& reference, Clip& optimized, Pose& restPose, float samplesPerSecond)
+{
+    ClipError result;
+    result.mMaxError = 0.0f;
+    result.mMaxErrorTime = 0.0f;
+    result.mMaxErrorJoint = -1;
+    float duration = reference.GetDuration();
+    if (duration <= 0.0f || samplesPerSecond <= 0.0f) {
+        return result;
+    }
+
+    vec3 points[4] = {
+        vec3(0, 0, 0), vec3(1, 0, 0), vec3(0, 1, 0), vec3(0, 0, 1)
+    };
+    Pose expected = restPose;
+    Pose actual = restPose;
+    unsigned int numJoints = restPose.Size();
+    unsigned int numSamples = 1 + (unsigned int)ceilf(duration * samplesPerSecond);
+    for (unsigned int i = 0; i < numSamples; ++i) {
+        float time = reference.GetStartTime() +
+            duration * ((float)i / (float)(numSamples > 1 ? numSamples - 1 : 1));
+        expected = restPose;
+        actual = restPose;
+        reference.Sample(expected, time);
+        optimized.Sample(actual, time);
+        expected.UpdateGlobalTransforms(); // GetGlobalTransform reads these
+        actual.UpdateGlobalTransforms();
+
+        for (unsigned int j = 0; j < numJoints; ++j) {
+            Transform a = expected.GetGlobalTransform(j);
+            Transform b = actual.GetGlobalTransform(j);
+            for (unsigned int p = 0; p < 4; ++p) {
+                vec3 diff = TransformPoint(a, points[p]) - TransformPoint(b, points[p]);
+                float error = sqrtf(LenSq(diff));
+                if (error > result.mMaxError) {
+                    result.mMaxError = error;
+                    result.mMaxErrorTime = time;
+                    result.mMaxErrorJoint = (int)j;
+                }
+            }
+        }
+    }
+    return result;
 }
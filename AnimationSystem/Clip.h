@@ -1,5 +1,5 @@
 #ifndef _H_CLIP_
-#define _H_ClIP_ 
+#define _H_CLIP_
 
 #include <vector>
 #include "Frame.h"
@@ -7,25 +7,104 @@
 #include "Pose.h"
 #include <string>
 
+// Joint ids below this are found through a table, larger ones such as an
+// invalid -1 id are found by searching the tracks instead
+#define CLIP_MAX_INDEXED_JOINT 65536
+
+// How Clip::Sample does the work, both give the same pose
+enum class SamplingBackend {
+	Scalar, // One joint at a time
+	// Linear rotations of many joints are interpolated together. The keys
+	// are still found one joint at a time since every track has its own
+	// key times, only the nlerp itself is batched.
+	Simd
+};
+
+// Playback position that stays precise however long a clip loops for,
+// the time is kept inside the clip and whole loops are counted apart.
+// The time is a double so adding small steps every frame does not drift.
+// mTime is measured from the clip's start time, so a default PlaybackTime
+// plays any clip from its first key.
+struct PlaybackTime {
+	double mTime;
+	int mLoops;
+
+	inline PlaybackTime() : mTime(0.0), mLoops(0) { }
+};
+
+// Per instance playback state for a clip. Sampling with a cursor only
+// reads the clip, so one loaded clip can be shared by any number of
+// characters and threads as long as each has its own cursor.
+struct ClipCursor {
+	std::vector<TransformTrackCursor> mTracks; // One per track
+	// Scratch space for the Simd backend
+	std::vector<RotationSegment> mRotationSegments;
+	std::vector<unsigned int> mRotationJoints;
+	std::vector<Quaternion> mRotations;
+};
+
 class Clip {
 protected:
 	std::vector<TransformTrack> mTracks;
+	std::vector<int> mTrackIndices; // Joint id -> index into mTracks, -1 if none
 	std::string mName;
 	float mStartTime;
 	float mEndTime;
 	bool mLooping;
+	bool mUniformInterpolation; // Every animated channel uses mInterpolation
+	Interpolation mInterpolation;
+	SamplingBackend mBackend;
+	ClipCursor mCursor; // Used by the non const Sample functions
 protected:
-	float AdjustTimeToFitRange(float inTime);
+	float AdjustTimeToFitRange(float inTime) const;
+	bool AdvancePlaybackTime(PlaybackTime& inOutTime, float deltaTime, float& outSampleTime, int& outWraps) const;
+	template<Interpolation I>
+	void SampleTracks(Transform* outLocals, unsigned int numJoints, float inTime, ClipCursor& cursor) const;
+	void SampleTracksBatched(Transform* outLocals, unsigned int numJoints, float inTime, ClipCursor& cursor) const;
+	void SampleInRange(Transform* outLocals, unsigned int numJoints, float inTime, ClipCursor& cursor) const;
+	void SampleInRange(Pose& outPose, float inTime, ClipCursor& cursor) const;
+	void RebuildTrackIndices();
+	void SetTrackIndex(unsigned int joint, int index);
+	void SortTracks(const std::vector<unsigned int>& keys);
 
 public:
 	Clip();
 	unsigned int GetIdAtIndex(unsigned int index);
 	void SetIdAtIndex(unsigned int idx, unsigned int id);
 	unsigned int Size();
+	int GetTrackIndex(unsigned int joint); // -1 if the joint has no track
 	float Sample(Pose& outPose, float inTime);
+	int Sample(Pose& outPose, PlaybackTime& inOutTime, float deltaTime);
+	// Thread safe, see ClipCursor. The clip must not be edited meanwhile.
+	float Sample(Pose& outPose, float inTime, ClipCursor& cursor) const;
+	int Sample(Pose& outPose, PlaybackTime& inOutTime, float deltaTime, ClipCursor& cursor) const;
+	// Same as above for any pose type, outLocals is indexed by joint and
+	// tracks for joints past numJoints are skipped
+	float Sample(Transform* outLocals, unsigned int numJoints, float inTime);
+	float Sample(Transform* outLocals, unsigned int numJoints, float inTime, ClipCursor& cursor) const;
+	int Sample(Transform* outLocals, unsigned int numJoints, PlaybackTime& inOutTime, float deltaTime, ClipCursor& cursor) const;
+	// Bakes the clip at count sorted times, outPoses[i] is the clip
+	// sampled at times[i] on top of restPose
+	void SampleBatch(Pose& restPose, const float* times, unsigned int count, std::vector<Pose>& outPoses) const;
 	TransformTrack& operator[](unsigned int index);
 
 	void RecalculateDuration();
+	void RecalculateInterpolation();
+	bool HasUniformInterpolation();
+	SamplingBackend GetSamplingBackend();
+	void SetSamplingBackend(SamplingBackend backend);
+	unsigned int GetIndexLookupTableSize();
+	void ClearIndexLookupTables();
+	// Precomputed cubic segments sample faster but use more memory
+	void SetCubicCoefficients(bool enabled);
+	unsigned int GetCubicCoefficientsSize();
+	unsigned int UpdateSharedTimelines(); // Returns how many tracks share
+	// Reorders tracks so sampling walks the pose in order, by joint id or
+	// with parents before their children
+	void SortTracks();
+	void SortTracks(Pose& hierarchy);
+	unsigned int GetKeyMemorySize();
+	void Quantize();
 	std::string& GetName();
 	void SetName(const std::string& inNewName);
 	float GetDuration();
@@ -35,5 +114,16 @@ public:
 	void SetLooping(bool inLooping);
 };
 
+// Largest world space difference between two versions of a clip. Each joint
+// is measured at its origin and one unit along its local axes, so rotation
+// error on leaf joints shows up as well.
+struct ClipError {
+	float mMaxError;
+	float mMaxErrorTime;
+	int mMaxErrorJoint;
+};
+
+ClipError MeasureClipError(Clip& reference, Clip& optimized, Pose& restPose, float samplesPerSecond);
+
 #endif // !_H_CLIP_
 
@@ -0,0 +1,174 @@
+#include "FastTrack.h"
+#include "TrackHelpers.h"
+#include <cmath>
+#include <cstring>
+
+template class FastTrack<float, 1>;
+template class FastTrack<vec3, 3>;
+template class FastTrack<Quaternion, 4>;
+
+template FastTrack<float, 1> OptimizeTrack(Track<float, 1>& input, float sampleRate);
+template FastTrack<vec3, 3> OptimizeTrack(Track<vec3, 3>& input, float sampleRate);
+template FastTrack<Quaternion, 4> OptimizeTrack(Track<Quaternion, 4>& input, float sampleRate);
+
+template TrackError MeasureTrackError(Track<float, 1>& reference, FastTrack<float, 1>& optimized, float samplesPerSecond);
+template TrackError MeasureTrackError(Track<vec3, 3>& reference, FastTrack<vec3, 3>& optimized, float samplesPerSecond);
+template TrackError MeasureTrackError(Track<Quaternion, 4>& reference, FastTrack<Quaternion, 4>& optimized, float samplesPerSecond);
+
+template<typename T, int N>
+FastTrack<T, N>::FastTrack() {
+	mInterpolation = Interpolation::Linear;
+	mStartTime = 0.0f;
+	mEndTime = 0.0f;
+	mSampleRate = 0.0f;
+}
+
+template<typename T, int N>
+void FastTrack<T, N>::Resize(unsigned int numSamples) {
+	mValues.resize(numSamples * N);
+}
+
+template<typename T, int N>
+unsigned int FastTrack<T, N>::Size() {
+	return (unsigned int)(mValues.size() / N);
+}
+
+template<typename T, int N>
+Interpolation FastTrack<T, N>::GetInterpolation() {
+	return mInterpolation;
+}
+
+template<typename T, int N>
+float FastTrack<T, N>::GetStartTime() {
+	return mStartTime;
+}
+
+template<typename T, int N>
+float FastTrack<T, N>::GetEndTime() {
+	return mEndTime;
+}
+
+template<typename T, int N>
+float FastTrack<T, N>::GetSampleRate() {
+	return mSampleRate;
+}
+
+template<> float FastTrack<float, 1>::Cast(const float* value) const {
+	return value[0];
+}
+
+template<> vec3 FastTrack<vec3, 3>::Cast(const float* value) const {
+	return vec3(value[0], value[1], value[2]);
+}
+
+template<> Quaternion FastTrack<Quaternion, 4>::Cast(const float* value) const {
+	return Quaternion(value[0], value[1], value[2], value[3]);
+}
+
+template<typename T, int N>
+void FastTrack<T, N>::Bake(Track<T, N>& input, float sampleRate) {
+	mValues.clear();
+	mSampleRate = 0.0f;
+	mInterpolation = input.GetInterpolation();
+	if (input.Size() <= 1 || sampleRate <= 0.0f) {
+		mStartTime = mEndTime = 0.0f;
+		if (input.Size() == 1) {
+			Resize(1);
+			memcpy(&mValues[0], input.GetFrame(0).mValue, N * sizeof(float));
+		}
+		return;
+	}
+
+	mStartTime = input.GetStartTime();
+	mEndTime = input.GetEndTime();
+	float duration = mEndTime - mStartTime;
+	if (duration <= 0.0f) {
+		return;
+	}
+
+	// Round the rate so the first and last samples land on the first
+	// and last keys of the input track
+	unsigned int numSamples = 1 + (unsigned int)ceilf(duration * sampleRate);
+	mSampleRate = (float)(numSamples - 1) / duration;
+	Resize(numSamples);
+
+	TrackCursor cursor;
+	for (unsigned int i = 0; i < numSamples; ++i) {
+		float time = mStartTime + duration * ((float)i / (float)(numSamples - 1));
+		T value = input.Sample(time, false, cursor);
+		memcpy(&mValues[i * N], &value, N * sizeof(float));
+	}
+}
+
+template<typename T, int N>
+T FastTrack<T, N>::Sample(float time, bool looping) const {
+	unsigned int size = (unsigned int)mValues.size() / N;
+	if (size <= 1) {
+		return T();
+	}
+
+	if (looping && (time < mStartTime || time >= mEndTime)) {
+		float duration = mEndTime - mStartTime;
+		time = fmodf(time - mStartTime, duration);
+		if (time < 0.0f) {
+			time += duration;
+		}
+		time = time + mStartTime;
+	}
+
+	float sample = (time - mStartTime) * mSampleRate;
+	if (sample <= 0.0f) {
+		return Cast(&mValues[0]);
+	}
+	unsigned int thisSample = (unsigned int)sample; // floor, sample is positive
+	if (thisSample >= size - 1) {
+		return Cast(&mValues[(size - 1) * N]);
+	}
+
+	T start = Cast(&mValues[thisSample * N]);
+	if (mInterpolation == Interpolation::Constant) {
+		return start;
+	}
+	T end = Cast(&mValues[(thisSample + 1) * N]);
+	return TrackHelpers::Interpolate(start, end, sample - (float)thisSample);
+}
+
+template<typename T, int N>
+FastTrack<T, N> OptimizeTrack(Track<T, N>& input, float sampleRate) {
+	FastTrack<T, N> result;
+	result.Bake(input, sampleRate);
+	return result;
+}
+
+template<typename T, int N>
+TrackError MeasureTrackError(Track<T, N>& reference, FastTrack<T, N>& optimized, float samplesPerSecond) {
+	TrackError result;
+	result.mMaxError = 0.0f;
+	result.mAverageError = 0.0f;
+	result.mMaxErrorTime = 0.0f;
+	result.mNumSamples = 0;
+	if (reference.Size() <= 1 || samplesPerSecond <= 0.0f) {
+		return result;
+	}
+
+	float startTime = reference.GetStartTime();
+	float duration = reference.GetEndTime() - startTime;
+	unsigned int numSamples = 1 + (unsigned int)ceilf(duration * samplesPerSecond);
+
+	TrackCursor cursor;
+	double total = 0.0;
+	for (unsigned int i = 0; i < numSamples; ++i) {
+		float time = startTime + duration * ((float)i / (float)(numSamples > 1 ? numSamples - 1 : 1));
+		T expected = reference.Sample(time, false, cursor);
+		T actual = optimized.Sample(time, false);
+		float error = TrackHelpers::Distance(expected, actual);
+		if (error > result.mMaxError) {
+			result.mMaxError = error;
+			result.mMaxErrorTime = time;
+		}
+		total += error;
+	}
+	result.mNumSamples = numSamples;
+	result.mAverageError = (float)(total / (double)numSamples);
+	return result;
+}
@@ -0,0 +1,52 @@
+#ifndef _H_FASTTRACK_
+#define _H_FASTTRACK_
+
+#include <vector>
+#include "Track.h"
+
+// Track resampled to a fixed rate, the key index is computed directly
+// from the time so sampling needs no search and no division
+template<typename T, int N>
+class FastTrack {
+protected:
+	std::vector<float> mValues; // N floats per sample
+	Interpolation mInterpolation;
+	float mStartTime;
+	float mEndTime;
+	float mSampleRate; // Samples per second
+
+protected:
+	T Cast(const float* value) const; // Will be specialized
+
+public:
+	FastTrack();
+	void Resize(unsigned int numSamples);
+	unsigned int Size();
+	Interpolation GetInterpolation();
+	float GetStartTime();
+	float GetEndTime();
+	float GetSampleRate();
+
+	void Bake(Track<T, N>& input, float sampleRate);
+	T Sample(float time, bool looping) const; // No state, thread safe
+};
+
+typedef FastTrack<float, 1> FastScalarTrack;
+typedef FastTrack<vec3, 3> FastVectorTrack;
+typedef FastTrack<Quaternion, 4> FastQuaternionTrack;
+
+// How closely a resampled track follows the track it was made from
+struct TrackError {
+	float mMaxError; // Radians for rotations, units otherwise
+	float mAverageError;
+	float mMaxErrorTime;
+	unsigned int mNumSamples;
+};
+
+template<typename T, int N>
+FastTrack<T, N> OptimizeTrack(Track<T, N>& input, float sampleRate);
+
+template<typename T, int N>
+TrackError MeasureTrackError(Track<T, N>& reference, FastTrack<T, N>& optimized, float samplesPerSecond);
+
+#endif // !_H_FASTTRACK_
@@ -0,0 +1,108 @@
+#include "FrameArena.h"
+#include <cstdlib>
+
+// Overflow blocks start with a link to the previous one
+struct FrameArenaOverflow {
+	void* mPrevious;
+	size_t mBytes;
+};
+
+FrameArena::FrameArena(size_t capacity) {
+	mMemory = (char*)malloc(capacity);
+	mCapacity = mMemory != 0 ? capacity : 0;
+	mOffset = 0;
+	mOverflow = 0;
+}
+
+FrameArena::~FrameArena() {
+	FreeOverflow(0);
+	free(mMemory);
+}
+
+void* FrameArena::Allocate(size_t bytes, size_t alignment) {
+	if (bytes == 0) {
+		bytes = 1;
+	}
+	size_t start = (mOffset + alignment - 1) & ~(alignment - 1);
+	void* result = 0;
+	if (start + bytes <= mCapacity) {
+		result = mMemory + start;
+		mStats.mBytes += start + bytes - mOffset;
+		mOffset = start + bytes;
+	}
+	else {
+		result = AllocateOverflow(bytes, alignment);
+	}
+	mStats.mAllocations += 1;
+	if (mStats.mBytes > mStats.mPeakBytes) {
+		mStats.mPeakBytes = mStats.mBytes;
+	}
+	return result;
+}
+
+void* FrameArena::AllocateOverflow(size_t bytes, size_t alignment) {
+	size_t header = (sizeof(FrameArenaOverflow) + alignment - 1) & ~(alignment - 1);
+	char* block = (char*)malloc(header + bytes);
+	if (block == 0) {
+		throw std::bad_alloc();
+	}
+	FrameArenaOverflow* overflow = (FrameArenaOverflow*)block;
+	overflow->mPrevious = mOverflow;
+	overflow->mBytes = header + bytes;
+	mOverflow = block;
+	mStats.mBytes += header + bytes;
+	mStats.mOverflowAllocations += 1;
+	mStats.mOverflowBytes += header + bytes;
+	return block + header;
+}
+
+// Frees overflow blocks until last is the newest one left
+void FrameArena::FreeOverflow(void* last) {
+	while (mOverflow != 0 && mOverflow != last) {
+		FrameArenaOverflow* overflow = (FrameArenaOverflow*)mOverflow;
+		mOverflow = overflow->mPrevious;
+		mStats.mBytes -= overflow->mBytes;
+		free(overflow);
+	}
+}
+
+void FrameArena::Reset() {
+	FreeOverflow(0);
+	mOffset = 0;
+	mLastFrameStats = mStats;
+	mStats = FrameArenaStats();
+}
+
+FrameArenaMarker FrameArena::GetMarker() {
+	FrameArenaMarker result;
+	result.mOffset = mOffset;
+	result.mOverflow = mOverflow;
+	return result;
+}
+
+void FrameArena::Rewind(const FrameArenaMarker& marker) {
+	FreeOverflow(marker.mOverflow);
+	mStats.mBytes -= mOffset - marker.mOffset;
+	mOffset = marker.mOffset;
+}
+
+size_t FrameArena::GetCapacity() {
+	return mCapacity;
+}
+
+size_t FrameArena::GetUsed() {
+	return mStats.mBytes;
+}
+
+const FrameArenaStats& FrameArena::GetFrameStats() {
+	return mStats;
+}
+
+const FrameArenaStats& FrameArena::GetLastFrameStats() {
+	return mLastFrameStats;
+}
+
+FrameArena& FrameArena::GetThreadArena() {
+	thread_local FrameArena arena(FRAME_ARENA_DEFAULT_SIZE);
+	return arena;
+}
@@ -0,0 +1,111 @@
+#ifndef _H_FRAMEARENA_
+#define _H_FRAMEARENA_
+
+#include <cstddef>
+#include <new>
+
+// Size of each thread's arena from FrameArena::GetThreadArena
+#define FRAME_ARENA_DEFAULT_SIZE (1024 * 1024)
+
+// What a frame asked of the arena. Overflow is memory that did not fit
+// and came from the heap instead, a sign the arena should be larger.
+struct FrameArenaStats {
+	size_t mBytes;
+	size_t mPeakBytes;
+	unsigned int mAllocations;
+	unsigned int mOverflowAllocations;
+	size_t mOverflowBytes;
+
+	inline FrameArenaStats() : mBytes(0), mPeakBytes(0), mAllocations(0),
+		mOverflowAllocations(0), mOverflowBytes(0) { }
+};
+
+// Everything allocated since a marker, see FrameArena::Rewind
+struct FrameArenaMarker {
+	size_t mOffset;
+	void* mOverflow;
+};
+
+// Linear allocator for memory that only lives for one frame: temporary
+// poses, palettes and sampling scratch. Allocating bumps an offset and
+// nothing is freed on its own, Reset releases everything at once at the
+// end of the frame. An arena must only be used by one thread, each
+// thread has its own from GetThreadArena.
+class FrameArena {
+protected:
+	char* mMemory;
+	size_t mCapacity;
+	size_t mOffset;
+	void* mOverflow; // Heap blocks, newest first, freed by Reset
+	FrameArenaStats mStats;
+	FrameArenaStats mLastFrameStats;
+protected:
+	void* AllocateOverflow(size_t bytes, size_t alignment);
+	void FreeOverflow(void* last);
+private:
+	FrameArena(const FrameArena&);
+	FrameArena& operator=(const FrameArena&);
+public:
+	FrameArena(size_t capacity);
+	~FrameArena();
+
+	void* Allocate(size_t bytes, size_t alignment);
+	// Default constructed, T must not need its destructor called
+	template<typename T>
+	T* Allocate(unsigned int count);
+
+	// Ends the frame, everything allocated is released
+	void Reset();
+	// Releases what was allocated after the marker, so a function can
+	// borrow scratch memory without waiting for the end of the frame
+	FrameArenaMarker GetMarker();
+	void Rewind(const FrameArenaMarker& marker);
+
+	size_t GetCapacity();
+	size_t GetUsed();
+	const FrameArenaStats& GetFrameStats(); // So far this frame
+	const FrameArenaStats& GetLastFrameStats(); // Before the last Reset
+
+	static FrameArena& GetThreadArena();
+};
+
+template<typename T>
+T* FrameArena::Allocate(unsigned int count) {
+	T* result = (T*)Allocate(sizeof(T) * count, alignof(T));
+	for (unsigned int i = 0; i < count; ++i) {
+		new (&result[i]) T();
+	}
+	return result;
+}
+
+// Lets standard containers use an arena, deallocate does nothing and
+// the memory comes back when the arena is reset. The container must not
+// outlive the frame.
+template<typename T>
+class FrameAllocator {
+public:
+	typedef T value_type;
+	FrameArena* mArena;
+
+	inline FrameAllocator() : mArena(&FrameArena::GetThreadArena()) { }
+	inline FrameAllocator(FrameArena& arena) : mArena(&arena) { }
+	template<typename U>
+	inline FrameAllocator(const FrameAllocator<U>& other) : mArena(other.mArena) { }
+
+	inline T* allocate(size_t count) {
+		return (T*)mArena->Allocate(sizeof(T) * count, alignof(T));
+	}
+	inline void deallocate(T*, size_t) { }
+};
+
+template<typename T, typename U>
+inline bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) {
+	return a.mArena == b.mArena;
+}
+
+template<typename T, typename U>
+inline bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) {
+	return a.mArena != b.mArena;
+}
+
+#endif
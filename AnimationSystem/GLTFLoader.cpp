@@ -1,6 +1,7 @@
 #include "GLTFLoader.h"
 #include <iostream>
 #include "Transform.h"
+#include "RearrangeBones.h"
 
 namespace GLTFHelpers {
 	Transform GetLocalTransform(cgltf_node& node) {
@@ -70,7 +71,7 @@ namespace GLTFHelpers {
 		inOutTrack.Resize(numFrames);
 		for (unsigned int i = 0; i < numFrames; ++i) {
 			int baseIndex = i * numberOfValuesPerFrame;
-			Frame<N>& frame = inOutTrack[i];
+			Frame<N> frame;
 			int offset = 0;
 
 			frame.mTime = timelineFloats[i];
@@ -86,9 +87,42 @@ namespace GLTFHelpers {
 			for (int component = 0; component < N; ++component) {
 				frame.mOut[component] = isSamplerCubic ? valueFloats[baseIndex + offset++] : 0.0f;
 			}
+
+			inOutTrack.SetFrame(i, frame);
 		}
+		inOutTrack.UpdateIndexLookupTable(TRACK_LOOKUP_SAMPLES_PER_SECOND);
 	}
 
+	template<typename T, int N>
+	void ReduceTrackKeys(Track<T, N>& inOutTrack, const ClipImportSettings& inSettings, ClipImportReport& outReport) {
+		if (inSettings.mKeyReductionTolerance > 0.0f) {
+			inOutTrack.ReduceKeys(inSettings.mKeyReductionTolerance);
+		}
+		outReport.mKeysAfter += inOutTrack.Size();
+	}
+
+	void ReduceClipKeys(Clip& inOutClip, const ClipImportSettings& inSettings, ClipImportReport& outReport) {
+		unsigned int size = inOutClip.Size();
+		for (unsigned int i = 0; i < size; ++i) {
+			TransformTrack& track = inOutClip[inOutClip.GetIdAtIndex(i)];
+			ReduceTrackKeys(track.GetPositionTrack(), inSettings, outReport);
+			ReduceTrackKeys(track.GetRotationTrack(), inSettings, outReport);
+			ReduceTrackKeys(track.GetScaleTrack(), inSettings, outReport);
+		}
+	}
+
+	void CollapseClipChannels(Clip& inOutClip, Pose& restPose, const ClipImportSettings& inSettings, ClipImportReport& outReport) {
+		unsigned int size = inOutClip.Size();
+		for (unsigned int i = 0; i < size; ++i) {
+			unsigned int joint = inOutClip.GetIdAtIndex(i);
+			TransformTrack& track = inOutClip[joint];
+			outReport.mChannelsCollapsed += track.CollapseConstantChannels(inSettings.mConstantChannelEpsilon);
+			if (inSettings.mRemoveRestPoseChannels) {
+				Transform rest = restPose.GetLocalTransform(joint);
+				outReport.mChannelsRemoved += track.RemoveConstantChannels(rest, inSettings.mConstantChannelEpsilon);
+			}
+		}
+	}
 
 } // End of GLTFHelpers
 
@@ -142,6 +176,51 @@ Pose LoadRestPose(cgltf_data* data) {
 	return result;
 }
 
+Pose LoadBindPose(cgltf_data* data) {
+	Pose restPose = LoadRestPose(data);
+	unsigned int numBones = restPose.Size();
+	std::vector<Transform> worldBindPose(numBones);
+	for (unsigned int i = 0; i < numBones; ++i) {
+		worldBindPose[i] = restPose.GetGlobalTransform(i);
+	}
+
+	// Joints a skin binds differently from the rest pose
+	unsigned int numSkins = (unsigned int)data->skins_count;
+	for (unsigned int i = 0; i < numSkins; ++i) {
+		cgltf_skin* skin = &(data->skins[i]);
+		if (skin->inverse_bind_matrices == 0) {
+			continue;
+		}
+		std::vector<float> invBindAccessor;
+		GLTFHelpers::GetScalarValues(invBindAccessor, 16, *skin->inverse_bind_matrices);
+
+		unsigned int numJoints = (unsigned int)skin->joints_count;
+		for (unsigned int j = 0; j < numJoints && (j + 1) * 16 <= invBindAccessor.size(); ++j) {
+			mat4 invBindMatrix(&invBindAccessor[j * 16]);
+			Transform bindTransform = Mat4ToTransform(inverse(invBindMatrix));
+			int jointIndex = GLTFHelpers::GetNodeIndex(skin->joints[j], data->nodes, numBones);
+			if (jointIndex >= 0) {
+				worldBindPose[jointIndex] = bindTransform;
+			}
+		}
+	}
+
+	Pose bindPose = restPose;
+	for (unsigned int i = 0; i < numBones; ++i) {
+		Transform current = worldBindPose[i];
+		int p = bindPose.GetParent(i);
+		if (p >= 0) {
+			current = Combine(Inverse(worldBindPose[p]), current);
+		}
+		bindPose.SetLocalTransform(i, current);
+	}
+	return bindPose;
+}
+
+Skeleton LoadSkeleton(cgltf_data* data) {
+	return Skeleton(LoadRestPose(data), LoadBindPose(data), LoadJointNames(data));
+}
+
 std::vector<std::string> LoadJointNames(cgltf_data* data) {
 	unsigned int boneCount = (unsigned int)data->nodes_count;
 	std::vector<std::string> result(boneCount, "Not Set");
@@ -161,35 +240,79 @@ std::vector<std::string> LoadJointNames(cgltf_data* data) {
 }
 
 std::vector<Clip> LoadAnimationClips(cgltf_data* data) {
+	ClipImportSettings settings;
+	std::vector<ClipImportReport> reports;
+	return LoadAnimationClips(data, settings, reports);
+}
+
+std::vector<Clip> LoadAnimationClips(cgltf_data* data, const ClipImportSettings& settings, std::vector<ClipImportReport>& outReports) {
 	unsigned int numClips = (unsigned int)data->animations_count;
 	unsigned int numNodes = (unsigned int)data->nodes_count;
 
 	std::vector<Clip> result;
 	result.resize(numClips);
+	outReports.clear();
+	outReports.resize(numClips);
+
+	Pose restPose;
+	if (settings.mRemoveRestPoseChannels) {
+		restPose = LoadRestPose(data);
+	}
 
 	for (unsigned int i = 0; i < numClips; ++i) {
 		result[i].SetName(data->animations[i].name);
+		outReports[i].mName = result[i].GetName();
 
 		unsigned int numChannels = (unsigned int)data->animations[i].channels_count;
 		for (unsigned int j = 0; j < numChannels; ++j) {
 			cgltf_animation_channel& channel = data->animations[i].channels[j];
 			cgltf_node* target = channel.target_node;
 			int nodeId = GLTFHelpers::GetNodeIndex(target, data->nodes, numNodes);
+			if (nodeId < 0) {
+				continue; // Animates something other than a node
+			}
 			if (channel.target_path == cgltf_animation_path_type_translation) {
 				VectorTrack& track = result[i][nodeId].GetPositionTrack();
 				GLTFHelpers::TrackFromChannel<vec3, 3>(track, channel);
+				outReports[i].mKeysBefore += track.Size();
 			}
 			else if (channel.target_path == cgltf_animation_path_type_scale) {
 				VectorTrack& track = result[i][nodeId].GetScaleTrack();
 				GLTFHelpers::TrackFromChannel<vec3, 3>(track, channel);
+				outReports[i].mKeysBefore += track.Size();
 			}
 			else if (channel.target_path == cgltf_animation_path_type_rotation) {
 				QuaternionTrack& track = result[i][nodeId].GetRotationTrack();
 				GLTFHelpers::TrackFromChannel<Quaternion, 4>(track, channel);
+				outReports[i].mKeysBefore += track.Size();
 			}
 		}
 		result[i].RecalculateDuration();
+		if (settings.mCollapseConstantChannels) {
+			GLTFHelpers::CollapseClipChannels(result[i], restPose, settings, outReports[i]);
+		}
+		// After collapsing, so only channels that still move are reduced
+		GLTFHelpers::ReduceClipKeys(result[i], settings, outReports[i]);
+		result[i].SetCubicCoefficients(settings.mCubicCoefficients);
+		// Exporters usually give every channel of a joint the same input
+		// accessor, comparing the times also catches copies of it
+		outReports[i].mSharedTimelines = result[i].UpdateSharedTimelines();
+		result[i].RecalculateInterpolation(); // Picks the sampling loop
 	}
 
 	return result;
 }
+
+Skeleton LoadRearrangedSkeleton(cgltf_data* data, bool depthFirst, const ClipImportSettings& settings,
+	std::vector<Clip>& outClips, std::vector<ClipImportReport>& outReports,
+	std::vector<unsigned int>& outNodeIndices) {
+	Skeleton result = LoadSkeleton(data);
+	// Loaded with glTF node ids, so the rest pose channel removal still
+	// compares against the matching joints
+	outClips = LoadAnimationClips(data, settings, outReports);
+	BoneMap boneMap = RearrangeSkeleton(result, depthFirst, outNodeIndices);
+	for (unsigned int i = 0; i < (unsigned int)outClips.size(); ++i) {
+		RearrangeClip(outClips[i], boneMap);
+	}
+	return result;
+}
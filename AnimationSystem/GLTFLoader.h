@@ -3,6 +3,7 @@
 
 #include "cgltf.h"
 #include "Pose.h"
+#include "Skeleton.h"
 #include "Clip.h"
 #include <vector>
 #include <string>
@@ -10,8 +11,47 @@
 cgltf_data* LoadGLTFFile(const char* path);
 void FreeGLTFFile(cgltf_data* handle);
 
+// Optional processing applied to clips while they are loaded
+struct ClipImportSettings {
+	float mKeyReductionTolerance; // Units or radians, 0 keeps every key
+	// Store unchanging channels as one value. Off by default so the
+	// settings free LoadAnimationClips loads clips exactly as stored.
+	bool mCollapseConstantChannels;
+	float mConstantChannelEpsilon;
+	// Drop constant channels that match the rest pose, clips must
+	// then be sampled on top of the rest pose
+	bool mRemoveRestPoseChannels;
+	bool mCubicCoefficients; // Faster cubic sampling for more memory
+
+	inline ClipImportSettings() : mKeyReductionTolerance(0.0f),
+		mCollapseConstantChannels(false), mConstantChannelEpsilon(0.00001f),
+		mRemoveRestPoseChannels(false), mCubicCoefficients(false) { }
+};
+
+// What the import did to a clip
+struct ClipImportReport {
+	std::string mName;
+	unsigned int mKeysBefore;
+	unsigned int mKeysAfter;
+	unsigned int mChannelsCollapsed;
+	unsigned int mChannelsRemoved;
+	unsigned int mSharedTimelines; // Tracks that search for keys once
+
+	inline ClipImportReport() : mKeysBefore(0), mKeysAfter(0),
+		mChannelsCollapsed(0), mChannelsRemoved(0), mSharedTimelines(0) { }
+};
+
 Pose LoadRestPose(cgltf_data* data);
+Pose LoadBindPose(cgltf_data* data); // Shares the rest pose's hierarchy
 std::vector<std::string> LoadJointNames(cgltf_data* data);
+Skeleton LoadSkeleton(cgltf_data* data);
 std::vector<Clip> LoadAnimationClips(cgltf_data* data);
+std::vector<Clip> LoadAnimationClips(cgltf_data* data, const ClipImportSettings& settings, std::vector<ClipImportReport>& outReports);
+// Loads the skeleton and every clip with the joints reordered together so
+// parents come before their children, see RearrangeSkeleton.
+// outNodeIndices maps each joint back to its glTF node.
+Skeleton LoadRearrangedSkeleton(cgltf_data* data, bool depthFirst, const ClipImportSettings& settings,
+	std::vector<Clip>& outClips, std::vector<ClipImportReport>& outReports,
+	std::vector<unsigned int>& outNodeIndices);
 
 #endif
\ No newline at end of file
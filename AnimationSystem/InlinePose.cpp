@@ -0,0 +1,137 @@
+#include "InlinePose.h"
+
+template class InlinePose<8>;
+template class InlinePose<16>;
+template class InlinePose<32>;
+
+template<unsigned int N>
+InlinePose<N>::InlinePose() {
+	mSize = 0;
+}
+
+template<unsigned int N>
+InlinePose<N>::InlinePose(unsigned int numJoints) {
+	mSize = 0;
+	Resize(numJoints);
+}
+
+template<unsigned int N>
+InlinePose<N>::InlinePose(Pose& pose) {
+	mSize = 0;
+	Set(pose);
+}
+
+template<unsigned int N>
+void InlinePose<N>::Resize(unsigned int size) {
+	if (size > N) {
+		size = N;
+	}
+	for (unsigned int i = mSize; i < size; ++i) {
+		mJoints[i] = Transform();
+		mParents[i] = -1;
+	}
+	mSize = size;
+}
+
+template<unsigned int N>
+unsigned int InlinePose<N>::Size() {
+	return mSize;
+}
+
+template<unsigned int N>
+unsigned int InlinePose<N>::Capacity() {
+	return N;
+}
+
+template<unsigned int N>
+void InlinePose<N>::Set(Pose& pose) {
+	Resize(pose.Size());
+	for (unsigned int i = 0; i < mSize; ++i) {
+		int parent = pose.GetParent(i);
+		mParents[i] = parent < (int)mSize ? parent : -1; // Dropped parents
+		mJoints[i] = pose.GetLocalTransform(i);
+	}
+}
+
+template<unsigned int N>
+void InlinePose<N>::Get(Pose& outPose) {
+	outPose.Resize(mSize);
+	for (unsigned int i = 0; i < mSize; ++i) {
+		outPose.SetParent(i, mParents[i]);
+		outPose.SetLocalTransform(i, mJoints[i]);
+	}
+}
+
+template<unsigned int N>
+int InlinePose<N>::GetParent(unsigned int index) {
+	return mParents[index];
+}
+
+template<unsigned int N>
+void InlinePose<N>::SetParent(unsigned int index, int parent) {
+	mParents[index] = parent;
+}
+
+template<unsigned int N>
+Transform InlinePose<N>::GetLocalTransform(unsigned int index) {
+	return mJoints[index];
+}
+
+template<unsigned int N>
+void InlinePose<N>::SetLocalTransform(unsigned int index, const Transform& transform) {
+	mJoints[index] = transform;
+}
+
+template<unsigned int N>
+Transform& InlinePose<N>::GetLocalTransformRef(unsigned int index) {
+	return mJoints[index];
+}
+
+template<unsigned int N>
+Transform* InlinePose<N>::GetLocalTransformData() {
+	return mJoints;
+}
+
+template<unsigned int N>
+Transform InlinePose<N>::GetGlobalTransform(unsigned int index) {
+	Transform result = mJoints[index];
+	for (int p = mParents[index]; p >= 0; p = mParents[p]) {
+		result = Combine(mJoints[p], result);
+	}
+	return result;
+}
+
+template<unsigned int N>
+void InlinePose<N>::GetGlobalTransforms(Transform* out) {
+	for (unsigned int i = 0; i < mSize; ++i) {
+		int parent = mParents[i];
+		if (parent < 0) {
+			out[i] = mJoints[i];
+		}
+		else if (parent < (int)i) { // Parent is already done
+			out[i] = Combine(out[parent], mJoints[i]);
+		}
+		else { // Out of order, walk the chain
+			out[i] = GetGlobalTransform(i);
+		}
+	}
+}
+
+template<unsigned int N>
+void InlinePose<N>::GetMatrixPalette(mat4* out) {
+	Transform globals[N];
+	GetGlobalTransforms(globals);
+	for (unsigned int i = 0; i < mSize; ++i) {
+		out[i] = TransformToMat4(globals[i]);
+	}
+}
+
+template<unsigned int N>
+void InlinePose<N>::GetMatrixPalette(std::vector<mat4>& out) {
+	if (out.size() != mSize) {
+		out.resize(mSize);
+	}
+	if (mSize != 0) {
+		GetMatrixPalette(&out[0]);
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef _H_INLINEPOSE_
+#define _H_INLINEPOSE_
+
+#include "Pose.h"
+#include "mat4.h"
+#include <vector>
+
+// A pose for small skeletons that keeps its joints inside the object, so
+// it never touches the heap and arrays of them are contiguous. Sample
+// into it with Clip::Sample(GetLocalTransformData(), Size(), ...).
+// Sizes past N are clamped to N.
+template<unsigned int N>
+class InlinePose {
+protected:
+	Transform mJoints[N];
+	int mParents[N];
+	unsigned int mSize;
+public:
+	InlinePose();
+	InlinePose(unsigned int numJoints);
+	InlinePose(Pose& pose);
+	void Resize(unsigned int size);
+	unsigned int Size();
+	static unsigned int Capacity();
+
+	void Set(Pose& pose);
+	void Get(Pose& outPose);
+
+	int GetParent(unsigned int index);
+	void SetParent(unsigned int index, int parent);
+	Transform GetLocalTransform(unsigned int index);
+	void SetLocalTransform(unsigned int index, const Transform& transform);
+	Transform& GetLocalTransformRef(unsigned int index);
+	Transform* GetLocalTransformData();
+
+	Transform GetGlobalTransform(unsigned int index);
+	void GetGlobalTransforms(Transform* out); // Size() transforms
+	void GetMatrixPalette(mat4* out); // Size() matrices
+	void GetMatrixPalette(std::vector<mat4>& out);
+};
+
+typedef InlinePose<8> InlinePose8;
+typedef InlinePose<16> InlinePose16;
+typedef InlinePose<32> InlinePose32;
+
+#endif
@@ -1,9 +1,21 @@
 #include "Pose.h"
+#include <cstring>
+#include <utility>
 
-Pose::Pose(){}
+Pose::Pose()
+{
+	mParents = EmptyHierarchy();
+	mGlobalsValid = false;
+	mFirstDirty = 0;
+	mParentsOrdered = false;
+}
 
 Pose::Pose(const Pose& p)
 {
+	mParents = p.mParents;
+	mGlobalsValid = false;
+	mFirstDirty = 0;
+	mParentsOrdered = false;
 	*this = p;
 }
 
@@ -12,16 +24,13 @@ Pose& Pose::operator=(const Pose& p)
 	if (&p == this) {
 		return *this;
 	}
-	if (mParents.size() != p.mParents.size()) {
-		mParents.resize(p.mParents.size());
+	mGlobalsValid = false;
+	if (mParents != p.mParents) {
+		mParents = p.mParents; // Only the locals are copied
 	}
 	if (mJoints.size() != p.mJoints.size()) {
 		mJoints.resize(p.mJoints.size());
 	}
-	if (mParents.size() != 0) {
-		memcpy(&mParents[0], &p.mParents[0],
-			sizeof(int) * mParents.size());
-	}
 	if (mJoints.size() != 0) {
 		memcpy(&mJoints[0], &p.mJoints[0],
 			sizeof(Transform) * mJoints.size());
@@ -29,15 +38,51 @@ Pose& Pose::operator=(const Pose& p)
 	return *this;
 }
 
+Pose::Pose(Pose&& p) noexcept
+{
+	mGlobalsValid = false;
+	mFirstDirty = 0;
+	mParentsOrdered = false;
+	*this = std::move(p);
+}
+
+Pose& Pose::operator=(Pose&& p) noexcept
+{
+	if (&p == this) {
+		return *this;
+	}
+	mJoints.swap(p.mJoints);
+	mParents.swap(p.mParents);
+	mGlobals.swap(p.mGlobals);
+	mDirty.swap(p.mDirty);
+	mGlobalsValid = p.mGlobalsValid;
+	mFirstDirty = p.mFirstDirty;
+	mParentsOrdered = p.mParentsOrdered;
+
+	// Whatever this pose held goes away with the other one
+	p.mJoints.clear();
+	p.mParents = EmptyHierarchy();
+	p.mGlobalsValid = false;
+	return *this;
+}
+
 Pose::Pose(unsigned int numJoints)
 {
+	mParents = EmptyHierarchy();
+	mGlobalsValid = false;
+	mFirstDirty = 0;
+	mParentsOrdered = false;
 	Resize(numJoints);
 }
 
 void Pose::Resize(unsigned int size)
 {
-	mParents.resize(size);
+	if (mParents->size() != size) {
+		MakeHierarchyUnique();
+		mParents->resize(size);
+	}
 	mJoints.resize(size);
+	mGlobalsValid = false;
 }
 
 unsigned int Pose::Size()
@@ -47,12 +92,49 @@ unsigned int Pose::Size()
 
 int Pose::GetParent(unsigned int index)
 {
-	return mParents[index];
+	return (*mParents)[index];
 }
 
 void Pose::SetParent(unsigned int index, int parent)
 {
-	mParents[index] = parent;
+	if ((*mParents)[index] == parent) {
+		return;
+	}
+	MakeHierarchyUnique();
+	(*mParents)[index] = parent;
+	mGlobalsValid = false;
+}
+
+void Pose::MakeHierarchyUnique()
+{
+	if (mParents.use_count() > 1) {
+		mParents = std::make_shared<std::vector<int>>(*mParents);
+	}
+}
+
+const std::shared_ptr<std::vector<int>>& Pose::EmptyHierarchy()
+{
+	// Shared by every empty pose, so creating one doesn't allocate
+	static const std::shared_ptr<std::vector<int>> empty =
+		std::make_shared<std::vector<int>>();
+	return empty;
+}
+
+bool Pose::ShareHierarchy(const Pose& other)
+{
+	if (mParents == other.mParents) {
+		return true;
+	}
+	if (*mParents != *other.mParents) {
+		return false;
+	}
+	mParents = other.mParents;
+	return true;
+}
+
+bool Pose::SharesHierarchy(const Pose& other)
+{
+	return mParents == other.mParents;
 }
 
 Transform Pose::GetLocalTransform(unsigned int index)
@@ -63,12 +145,44 @@ Transform Pose::GetLocalTransform(unsigned int index)
 void Pose::SetLocalTransform(unsigned int index, const Transform& transform)
 {
 	mJoints[index] = transform;
+	MarkDirty(index);
+}
+
+Transform& Pose::GetLocalTransformRef(unsigned int index)
+{
+	MarkDirty(index); // Assume it gets written
+	return mJoints[index];
+}
+
+Transform* Pose::GetLocalTransformData()
+{
+	return mJoints.data();
+}
+
+void Pose::MarkDirty(unsigned int index)
+{
+	if (!mGlobalsValid) {
+		return; // Everything gets recomputed anyway
+	}
+	mDirty[index] = 1;
+	if (index < mFirstDirty) {
+		mFirstDirty = index;
+	}
+}
+
+bool Pose::HasDirtyJoints()
+{
+	return !mGlobalsValid || mFirstDirty < Size();
 }
 
 Transform Pose::GetGlobalTransform(unsigned int index)
 {
+	if (mGlobalsValid && mFirstDirty >= Size()) {
+		return mGlobals[index];
+	}
+	const std::vector<int>& parents = *mParents;
 	Transform result = mJoints[index];
-	for (int p = mParents[index]; p >= 0; p = mParents[p]) {
+	for (int p = parents[index]; p >= 0; p = parents[p]) {
 		result = Combine(mJoints[p], result);
 	}
 	return result;
@@ -79,15 +193,105 @@ Transform Pose::operator[](unsigned int index)
 	return GetGlobalTransform(index);
 }
 
+void Pose::UpdateGlobalTransforms()
+{
+	if (mGlobalsValid) {
+		UpdateDirtyGlobalTransforms();
+		return;
+	}
+	unsigned int size = Size();
+	mGlobals.resize(size);
+	mParentsOrdered = true;
+	const std::vector<int>& parents = *mParents;
+	for (unsigned int i = 0; i < size; ++i) {
+		int parent = parents[i];
+		if (parent < 0) {
+			mGlobals[i] = mJoints[i];
+		}
+		else if (parent < (int)i) { // Parent is already done
+			mGlobals[i] = Combine(mGlobals[parent], mJoints[i]);
+		}
+		else { // Out of order, walk the chain
+			mGlobals[i] = GetGlobalTransform(i);
+			mParentsOrdered = false;
+		}
+	}
+	mDirty.assign(size, 0);
+	mFirstDirty = size;
+	mGlobalsValid = true;
+}
+
+void Pose::UpdateDirtyGlobalTransforms()
+{
+	unsigned int size = Size();
+	if (mFirstDirty >= size) {
+		return;
+	}
+	// Children come after their parents, so nothing before the first
+	// dirty joint can be affected. Otherwise every joint is checked.
+	unsigned int start = mParentsOrdered ? mFirstDirty : 0;
+	const std::vector<int>& parents = *mParents;
+	for (unsigned int i = start; i < size; ++i) {
+		int parent = parents[i];
+		if (parent >= 0 && parent < (int)i) {
+			if (mDirty[parent]) {
+				mDirty[i] = 1; // Pass the change down the subtree
+			}
+			if (mDirty[i]) {
+				mGlobals[i] = Combine(mGlobals[parent], mJoints[i]);
+			}
+		}
+		else if (parent < 0) {
+			if (mDirty[i]) {
+				mGlobals[i] = mJoints[i];
+			}
+		}
+		else { // Out of order, any dirty ancestor means a walk
+			for (int p = parent; p >= 0 && !mDirty[i]; p = parents[p]) {
+				mDirty[i] = mDirty[p];
+			}
+			if (mDirty[i]) {
+				Transform result = mJoints[i];
+				for (int p = parent; p >= 0; p = parents[p]) {
+					result = Combine(mJoints[p], result);
+				}
+				mGlobals[i] = result;
+			}
+		}
+	}
+	memset(&mDirty[start], 0, size - start);
+	mFirstDirty = size;
+}
+
+void Pose::RefreshGlobalTransforms()
+{
+	mGlobalsValid = false;
+	UpdateGlobalTransforms();
+}
+
+const std::vector<Transform>& Pose::GetGlobalTransforms()
+{
+	UpdateGlobalTransforms();
+	return mGlobals;
+}
+
 void Pose::GetMatrixPalette(std::vector<mat4>& out)
 {
 	unsigned int size = Size();
 	if (out.size() != size) {
 		out.resize(size);
 	}
+	if (size != 0) {
+		GetMatrixPalette(&out[0]);
+	}
+}
+
+void Pose::GetMatrixPalette(mat4* out)
+{
+	unsigned int size = Size();
+	UpdateGlobalTransforms();
 	for (unsigned int i = 0; i < size; ++i) {
-		Transform t = GetGlobalTransform(i);
-		out[i] = TransformToMat4(t);
+		out[i] = TransformToMat4(mGlobals[i]);
 	}
 }
 
@@ -96,17 +300,18 @@ bool Pose::operator==(const Pose& other)
 	if (mJoints.size() != other.mJoints.size()) {
 		return false;
 	}
-	if (mParents.size() != other.mParents.size()) {
+	if (mParents->size() != other.mParents->size()) {
 		return false;
 	}
+	bool sameHierarchy = mParents == other.mParents;
 
 	unsigned int size = (unsigned int)mJoints.size();
 	for (unsigned int i = 0; i < size; ++i) {
 		Transform thisLocal = mJoints[i];
 		Transform otherLocal = other.mJoints[i];
-		int thisParent = mParents[i];
-		int otherParent = other.mParents[i];
-		if (thisParent != otherParent) { return false; }
+		if (!sameHierarchy && (*mParents)[i] != (*other.mParents)[i]) {
+			return false;
+		}
 		if (thisLocal.position != otherLocal.position) {
 			return false;
 		}
@@ -3,28 +3,64 @@
 
 #include "Transform.h"
 #include <vector>
+#include <memory>
 
 class Pose {
 protected:
 	std::vector<Transform> mJoints;
-	std::vector<int> mParents;
+	// The hierarchy is shared between copies of a pose, so instances of
+	// the same skeleton only store their own local transforms. It is
+	// copied before the first write when more than one pose uses it.
+	std::shared_ptr<std::vector<int>> mParents;
+	// Global transforms from the last UpdateGlobalTransforms. Changing a
+	// parent invalidates all of them, changing a local transform only
+	// marks that joint so its subtree is redone on the next update.
+	std::vector<Transform> mGlobals;
+	bool mGlobalsValid;
+	std::vector<unsigned char> mDirty;
+	unsigned int mFirstDirty; // Mirrors Size() when nothing is dirty
+	bool mParentsOrdered; // Every parent comes before its children
+	void MakeHierarchyUnique();
+	static const std::shared_ptr<std::vector<int>>& EmptyHierarchy();
+	void UpdateDirtyGlobalTransforms();
 
 public:
 	Pose();
 	Pose(const Pose& p);
+	// Reuses the existing storage, no allocation when the sizes match
 	Pose& operator=(const Pose& p);
+	// The moved from pose is left empty
+	Pose(Pose&& p) noexcept;
+	Pose& operator=(Pose&& p) noexcept;
 	Pose(unsigned int numJoints);
 	void Resize(unsigned int size);
 	unsigned int Size();
 	int GetParent(unsigned int index);
 	void SetParent(unsigned int index, int parent);
+	// Uses the other pose's hierarchy if the parents match, returns
+	// false and changes nothing if they don't
+	bool ShareHierarchy(const Pose& other);
+	bool SharesHierarchy(const Pose& other);
 
 	Transform GetLocalTransform(unsigned int index);
 	void SetLocalTransform(unsigned int index, const Transform& transform);
+	Transform& GetLocalTransformRef(unsigned int index); // Edit in place
+	// Every local transform for bulk writers like Clip::Sample, call
+	// MarkDirty for each joint written through it
+	Transform* GetLocalTransformData();
+	void MarkDirty(unsigned int index);
 	Transform GetGlobalTransform(unsigned int index);
+	// One pass over the joints, each global reuses its parent's. Fastest
+	// when parents come before their children. Only the subtrees under
+	// joints that changed since the last update are recomputed.
+	void UpdateGlobalTransforms();
+	void RefreshGlobalTransforms(); // Recomputes every joint
+	bool HasDirtyJoints();
+	const std::vector<Transform>& GetGlobalTransforms(); // Updates if needed
 	Transform operator[](unsigned int index);
 
 	void GetMatrixPalette(std::vector<mat4>& out);
+	void GetMatrixPalette(mat4* out); // Size() matrices, e.g. from a FrameArena
 	bool operator==(const Pose& other);
 	bool operator!=(const Pose& other);
 };
@@ -0,0 +1,269 @@
+#include "QuantizedTrack.h"
+#include "TrackHelpers.h"
+#include <cmath>
+#include <cstring>
+
+template class QuantizedTrack<vec3, 3>;
+template class QuantizedTrack<Quaternion, 4>;
+
+namespace QuantizeHelpers {
+	// The three smallest components of a unit quaternion are within +-1/sqrt(2)
+	const float kSmallestThreeRange = 0.707106781f;
+	const float kFifteenBitMax = 32767.0f;
+
+	inline unsigned short PackComponent(float f) {
+		float n = (f / kSmallestThreeRange) * 0.5f + 0.5f; // 0 to 1
+		if (n < 0.0f) { n = 0.0f; }
+		if (n > 1.0f) { n = 1.0f; }
+		return (unsigned short)(n * kFifteenBitMax + 0.5f);
+	}
+
+	inline float UnpackComponent(unsigned short s) {
+		float n = (float)(s & 0x7FFF) / kFifteenBitMax;
+		return (n * 2.0f - 1.0f) * kSmallestThreeRange;
+	}
+}
+
+template<typename T, int N>
+QuantizedTrack<T, N>::QuantizedTrack() {
+	mInterpolation = Interpolation::Linear;
+	mScale = vec3(0, 0, 0);
+}
+
+template<typename T, int N>
+unsigned int QuantizedTrack<T, N>::Size() const {
+	return (unsigned int)mTimes.size();
+}
+
+template<typename T, int N>
+Interpolation QuantizedTrack<T, N>::GetInterpolation() {
+	return mInterpolation;
+}
+
+template<typename T, int N>
+float QuantizedTrack<T, N>::GetStartTime() {
+	return mTimes[0];
+}
+
+template<typename T, int N>
+float QuantizedTrack<T, N>::GetEndTime() {
+	return mTimes[mTimes.size() - 1];
+}
+
+template<typename T, int N>
+unsigned int QuantizedTrack<T, N>::GetKeyMemorySize() {
+	return (unsigned int)(mTimes.size() * sizeof(float) +
+		mValues.size() * sizeof(unsigned short));
+}
+
+template<> void QuantizedTrack<vec3, 3>::Encode(const vec3& value, unsigned short* out) {
+	for (int i = 0; i < 3; ++i) {
+		float n = mScale.v[i] > 0.0f ? (value.v[i] - mMin.v[i]) / (mScale.v[i] * 65535.0f) : 0.0f;
+		if (n < 0.0f) { n = 0.0f; }
+		if (n > 1.0f) { n = 1.0f; }
+		out[i] = (unsigned short)(n * 65535.0f + 0.5f);
+	}
+}
+
+template<> vec3 QuantizedTrack<vec3, 3>::Decode(const unsigned short* value) const {
+	return vec3(
+		mMin.x + (float)value[0] * mScale.x,
+		mMin.y + (float)value[1] * mScale.y,
+		mMin.z + (float)value[2] * mScale.z);
+}
+
+template<> void QuantizedTrack<Quaternion, 4>::Encode(const Quaternion& value, unsigned short* out) {
+	Quaternion q = Normalised(value);
+	unsigned int largest = 0;
+	for (unsigned int i = 1; i < 4; ++i) {
+		if (fabsf(q.v[i]) > fabsf(q.v[largest])) {
+			largest = i;
+		}
+	}
+	if (q.v[largest] < 0.0f) { // q and -q are the same rotation
+		q = -q;
+	}
+
+	unsigned short packed[3];
+	for (unsigned int i = 0, j = 0; i < 4; ++i) {
+		if (i != largest) {
+			packed[j++] = QuantizeHelpers::PackComponent(q.v[i]);
+		}
+	}
+	// Two bits for the index of the dropped component, in the top bits
+	out[0] = packed[0] | (unsigned short)((largest >> 1) << 15);
+	out[1] = packed[1] | (unsigned short)((largest & 1) << 15);
+	out[2] = packed[2];
+}
+
+template<> Quaternion QuantizedTrack<Quaternion, 4>::Decode(const unsigned short* value) const {
+	unsigned int largest = ((value[0] >> 15) << 1) | (value[1] >> 15);
+	Quaternion result;
+	float sumSq = 0.0f;
+	for (unsigned int i = 0, j = 0; i < 4; ++i) {
+		if (i != largest) {
+			result.v[i] = QuantizeHelpers::UnpackComponent(value[j++]);
+			sumSq += result.v[i] * result.v[i];
+		}
+	}
+	result.v[largest] = sumSq < 1.0f ? sqrtf(1.0f - sumSq) : 0.0f;
+	return result;
+}
+
+template<> void QuantizedTrack<vec3, 3>::UpdateRange(const std::vector<vec3>& values) {
+	vec3 minimum = values[0];
+	vec3 maximum = values[0];
+	for (unsigned int i = 1; i < values.size(); ++i) {
+		for (int c = 0; c < 3; ++c) {
+			if (values[i].v[c] < minimum.v[c]) { minimum.v[c] = values[i].v[c]; }
+			if (values[i].v[c] > maximum.v[c]) { maximum.v[c] = values[i].v[c]; }
+		}
+	}
+	mMin = minimum;
+	mScale = (maximum - minimum) * (1.0f / 65535.0f);
+}
+
+template<> void QuantizedTrack<Quaternion, 4>::UpdateRange(const std::vector<Quaternion>&) {
+	// Unit quaternions always use the same range, the keys aren't needed
+}
+
+template<typename T, int N>
+void QuantizedTrack<T, N>::Quantize(Track<T, N>& input) {
+	mTimes.clear();
+	mValues.clear();
+	mCursor.Reset();
+	mInterpolation = input.GetInterpolation();
+	unsigned int size = input.Size();
+	if (size == 0) {
+		return;
+	}
+
+	std::vector<T> values;
+	if (mInterpolation == Interpolation::Cubic && size > 1) {
+		// Quantized keys are sampled with lerp / nlerp, so cubic tracks
+		// are baked into linear keys first
+		mInterpolation = Interpolation::Linear;
+		float startTime = input.GetStartTime();
+		float duration = input.GetEndTime() - startTime;
+		unsigned int numSamples = 1 + (unsigned int)ceilf(duration * QUANTIZED_CUBIC_SAMPLES_PER_SECOND);
+		if (numSamples < 2) {
+			numSamples = 2;
+		}
+		TrackCursor cursor;
+		for (unsigned int i = 0; i < numSamples; ++i) {
+			float time = startTime + duration * ((float)i / (float)(numSamples - 1));
+			mTimes.push_back(time);
+			values.push_back(input.Sample(time, false, cursor));
+		}
+	}
+	else {
+		values.resize(size);
+		for (unsigned int i = 0; i < size; ++i) {
+			Frame<N> frame = input.GetFrame(i);
+			mTimes.push_back(frame.mTime);
+			memcpy(&values[i], frame.mValue, N * sizeof(float));
+		}
+	}
+
+	UpdateRange(values);
+	mValues.resize(values.size() * 3);
+	for (unsigned int i = 0; i < values.size(); ++i) {
+		Encode(values[i], &mValues[i * 3]);
+	}
+}
+
+template<typename T, int N>
+int QuantizedTrack<T, N>::FrameIndex(float time, bool looping, TrackCursor& cursor) const {
+	int size = (int)mTimes.size();
+	if (size <= 1) {
+		return -1;
+	}
+	time = AdjustTimeToFitTrack(time, looping);
+
+	// Walk from the last sampled key, search if that does not find it
+	int last = size - 2;
+	int frame = cursor.mFrame;
+	if (frame < 0 || frame > last) {
+		frame = 0;
+	}
+	int steps = 0;
+	while (frame < last && time >= mTimes[frame + 1] && steps < TRACK_CURSOR_MAX_STEPS) {
+		++frame;
+		++steps;
+	}
+	while (frame > 0 && time < mTimes[frame] && steps < TRACK_CURSOR_MAX_STEPS) {
+		--frame;
+		++steps;
+	}
+	if ((frame != 0 && time < mTimes[frame]) ||
+		(frame != last && time >= mTimes[frame + 1])) {
+		int low = 0;
+		int high = last;
+		while (low < high) {
+			int mid = (low + high + 1) / 2;
+			if (time >= mTimes[mid]) {
+				low = mid;
+			}
+			else {
+				high = mid - 1;
+			}
+		}
+		frame = low;
+	}
+	cursor.mFrame = frame;
+	return frame;
+}
+
+template<typename T, int N>
+float QuantizedTrack<T, N>::AdjustTimeToFitTrack(float time, bool looping) const {
+	float startTime = mTimes[0];
+	float endTime = mTimes[mTimes.size() - 1];
+	float duration = endTime - startTime;
+	if (duration <= 0.0f) {
+		return startTime;
+	}
+	if (looping && (time < startTime || time >= endTime)) {
+		time = fmodf(time - startTime, duration);
+		if (time < 0.0f) {
+			time += duration;
+		}
+		return time + startTime;
+	}
+	if (time < startTime) {
+		return startTime;
+	}
+	if (time > endTime) {
+		return endTime;
+	}
+	return time;
+}
+
+template<typename T, int N>
+T QuantizedTrack<T, N>::Sample(float time, bool looping) {
+	return Sample(time, looping, mCursor);
+}
+
+template<typename T, int N>
+T QuantizedTrack<T, N>::Sample(float time, bool looping, TrackCursor& cursor) const {
+	int thisFrame = FrameIndex(time, looping, cursor);
+	if (thisFrame < 0) {
+		return T();
+	}
+	T start = Decode(&mValues[thisFrame * 3]);
+	if (mInterpolation == Interpolation::Constant) {
+		return start;
+	}
+
+	int nextFrame = thisFrame + 1;
+	float trackTime = AdjustTimeToFitTrack(time, looping);
+	float frameDelta = mTimes[nextFrame] - mTimes[thisFrame];
+	if (frameDelta <= 0.0f) {
+		return start;
+	}
+	float t = (trackTime - mTimes[thisFrame]) / frameDelta;
+	if (t > 1.0f) {
+		t = 1.0f;
+	}
+	T end = Decode(&mValues[nextFrame * 3]);
+	return TrackHelpers::Interpolate(start, end, t);
+}
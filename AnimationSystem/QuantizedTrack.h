@@ -0,0 +1,46 @@
+#ifndef _H_QUANTIZEDTRACK_
+#define _H_QUANTIZEDTRACK_
+
+#include <vector>
+#include "Track.h"
+
+// Sample rate used to bake cubic tracks into linear keys before quantizing
+#define QUANTIZED_CUBIC_SAMPLES_PER_SECOND 30.0f
+
+// Track with every key packed into three 16 bit values. Vectors are
+// normalized against the range of the track, rotations are stored as the
+// smallest three components of the quaternion (48 bits per key).
+template<typename T, int N>
+class QuantizedTrack {
+protected:
+	std::vector<float> mTimes;
+	std::vector<unsigned short> mValues; // 3 per key
+	Interpolation mInterpolation;
+	TrackCursor mCursor;
+	vec3 mMin; // Vector tracks only
+	vec3 mScale; // Range of the track / 65535, vector tracks only
+
+protected:
+	void UpdateRange(const std::vector<T>& values); // Will be specialized
+	void Encode(const T& value, unsigned short* out); // Will be specialized
+	T Decode(const unsigned short* value) const; // Will be specialized
+	int FrameIndex(float time, bool looping, TrackCursor& cursor) const;
+	float AdjustTimeToFitTrack(float time, bool looping) const;
+
+public:
+	QuantizedTrack();
+	unsigned int Size() const;
+	Interpolation GetInterpolation();
+	float GetStartTime();
+	float GetEndTime();
+	unsigned int GetKeyMemorySize(); // In bytes
+
+	void Quantize(Track<T, N>& input);
+	T Sample(float time, bool looping);
+	T Sample(float time, bool looping, TrackCursor& cursor) const; // Thread safe
+};
+
+typedef QuantizedTrack<vec3, 3> QuantizedVectorTrack;
+typedef QuantizedTrack<Quaternion, 4> QuantizedQuaternionTrack;
+
+#endif // !_H_QUANTIZEDTRACK_
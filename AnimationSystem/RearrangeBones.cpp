@@ -0,0 +1,110 @@
+#include "RearrangeBones.h"
+
+BoneMap RearrangeJoints(Pose& inOutRestPose, std::vector<std::string>& inOutNames,
+	bool depthFirst, std::vector<unsigned int>& outOriginalIndices) {
+	unsigned int size = inOutRestPose.Size();
+	std::vector<std::vector<unsigned int>> children(size);
+	std::vector<unsigned int> roots;
+	for (unsigned int i = 0; i < size; ++i) {
+		int parent = inOutRestPose.GetParent(i);
+		if (parent >= 0 && parent < (int)size) {
+			children[parent].push_back(i);
+		}
+		else {
+			roots.push_back(i);
+		}
+	}
+
+	// Visit from the roots, siblings keep their original order
+	outOriginalIndices.clear();
+	outOriginalIndices.reserve(size);
+	std::vector<bool> visited(size, false);
+	if (depthFirst) {
+		std::vector<unsigned int> stack(roots.rbegin(), roots.rend());
+		while (!stack.empty()) {
+			unsigned int joint = stack.back();
+			stack.pop_back();
+			if (visited[joint]) {
+				continue;
+			}
+			visited[joint] = true;
+			outOriginalIndices.push_back(joint);
+			for (unsigned int i = (unsigned int)children[joint].size(); i > 0; --i) {
+				stack.push_back(children[joint][i - 1]);
+			}
+		}
+	}
+	else {
+		outOriginalIndices = roots;
+		for (unsigned int i = 0; i < roots.size(); ++i) {
+			visited[roots[i]] = true;
+		}
+		for (unsigned int i = 0; i < outOriginalIndices.size(); ++i) {
+			unsigned int joint = outOriginalIndices[i];
+			for (unsigned int j = 0; j < children[joint].size(); ++j) {
+				unsigned int child = children[joint][j];
+				if (!visited[child]) {
+					visited[child] = true;
+					outOriginalIndices.push_back(child);
+				}
+			}
+		}
+	}
+	for (unsigned int i = 0; i < size; ++i) {
+		if (!visited[i]) { // Part of a cycle, keep it rather than lose it
+			outOriginalIndices.push_back(i);
+		}
+	}
+
+	BoneMap result;
+	result[-1] = -1;
+	for (unsigned int i = 0; i < size; ++i) {
+		result[(int)outOriginalIndices[i]] = (int)i;
+	}
+
+	Pose rearranged(size);
+	std::vector<std::string> names(inOutNames.size());
+	for (unsigned int i = 0; i < size; ++i) {
+		unsigned int original = outOriginalIndices[i];
+		rearranged.SetLocalTransform(i, inOutRestPose.GetLocalTransform(original));
+		int parent = inOutRestPose.GetParent(original);
+		BoneMap::iterator it = result.find(parent);
+		rearranged.SetParent(i, it != result.end() ? it->second : -1);
+		if (original < inOutNames.size() && i < names.size()) {
+			names[i] = inOutNames[original];
+		}
+	}
+	inOutRestPose = rearranged;
+	if (inOutNames.size() == size) {
+		inOutNames = names;
+	}
+	return result;
+}
+
+BoneMap RearrangeSkeleton(Skeleton& inOutSkeleton, bool depthFirst,
+	std::vector<unsigned int>& outOriginalIndices) {
+	Pose rest = inOutSkeleton.GetRestPose();
+	Pose bind = inOutSkeleton.GetBindPose();
+	std::vector<std::string> names = inOutSkeleton.GetJointNames();
+	BoneMap result = RearrangeJoints(rest, names, depthFirst, outOriginalIndices);
+
+	Pose rearrangedBind = rest;
+	unsigned int size = rest.Size();
+	for (unsigned int i = 0; i < size; ++i) {
+		rearrangedBind.SetLocalTransform(i, bind.GetLocalTransform(outOriginalIndices[i]));
+	}
+	inOutSkeleton.Set(rest, rearrangedBind, names);
+	return result;
+}
+
+void RearrangeClip(Clip& inOutClip, BoneMap& boneMap) {
+	unsigned int size = inOutClip.Size();
+	for (unsigned int i = 0; i < size; ++i) {
+		int joint = (int)inOutClip.GetIdAtIndex(i);
+		BoneMap::iterator it = boneMap.find(joint);
+		if (it != boneMap.end()) {
+			inOutClip.SetIdAtIndex(i, (unsigned int)it->second);
+		}
+	}
+	inOutClip.SortTracks(); // Sample in the new joint order
+}
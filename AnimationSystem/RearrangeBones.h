@@ -0,0 +1,27 @@
+#ifndef _H_REARRANGEBONES_
+#define _H_REARRANGEBONES_
+
+#include <map>
+#include <vector>
+#include <string>
+#include "Pose.h"
+#include "Skeleton.h"
+#include "Clip.h"
+
+// Old joint index -> new joint index
+typedef std::map<int, int> BoneMap;
+
+// Reorders the joints of a rest pose so every parent comes before its
+// children, which the single pass hierarchy updates rely on. Depth first
+// keeps each subtree together, otherwise joints are sorted by depth.
+// outOriginalIndices maps each new index back to the joint's index in
+// the pose passed in, which is its glTF node for a pose just loaded.
+BoneMap RearrangeJoints(Pose& inOutRestPose, std::vector<std::string>& inOutNames,
+	bool depthFirst, std::vector<unsigned int>& outOriginalIndices);
+// Same as RearrangeJoints, the bind pose is reordered to match
+BoneMap RearrangeSkeleton(Skeleton& inOutSkeleton, bool depthFirst,
+	std::vector<unsigned int>& outOriginalIndices);
+// Every clip loaded with the pose has to be remapped the same way
+void RearrangeClip(Clip& inOutClip, BoneMap& boneMap);
+
+#endif
@@ -0,0 +1,81 @@
+#include "RotationBatch.h"
+#include "TrackHelpers.h"
+#ifdef ROTATION_BATCH_SSE
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+void NlerpBatchScalar(const RotationSegment* segments, unsigned int count, Quaternion* outRotations) {
+	for (unsigned int i = 0; i < count; ++i) {
+		outRotations[i] = TrackHelpers::Interpolate(segments[i].mStart,
+			segments[i].mEnd, segments[i].mT);
+	}
+}
+
+#ifdef ROTATION_BATCH_SSE
+
+void NlerpBatch(const RotationSegment* segments, unsigned int count, Quaternion* outRotations) {
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 epsilon = _mm_set1_ps(QUAT_EPSILON);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		const RotationSegment* s = &segments[i];
+		// Four quaternions per register, transposed so each register
+		// holds one component of all four
+		__m128 ax = _mm_loadu_ps(s[0].mStart.v);
+		__m128 ay = _mm_loadu_ps(s[1].mStart.v);
+		__m128 az = _mm_loadu_ps(s[2].mStart.v);
+		__m128 aw = _mm_loadu_ps(s[3].mStart.v);
+		_MM_TRANSPOSE4_PS(ax, ay, az, aw);
+		__m128 bx = _mm_loadu_ps(s[0].mEnd.v);
+		__m128 by = _mm_loadu_ps(s[1].mEnd.v);
+		__m128 bz = _mm_loadu_ps(s[2].mEnd.v);
+		__m128 bw = _mm_loadu_ps(s[3].mEnd.v);
+		_MM_TRANSPOSE4_PS(bx, by, bz, bw);
+		__m128 t = _mm_setr_ps(s[0].mT, s[1].mT, s[2].mT, s[3].mT);
+
+		// Neighborhood, flip the end key where the dot product is negative
+		__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+			_mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(dot, _mm_setzero_ps()), signBit);
+		bx = _mm_xor_ps(bx, flip);
+		by = _mm_xor_ps(by, flip);
+		bz = _mm_xor_ps(bz, flip);
+		bw = _mm_xor_ps(bw, flip);
+
+		__m128 s1 = _mm_sub_ps(one, t);
+		__m128 rx = _mm_add_ps(_mm_mul_ps(ax, s1), _mm_mul_ps(bx, t));
+		__m128 ry = _mm_add_ps(_mm_mul_ps(ay, s1), _mm_mul_ps(by, t));
+		__m128 rz = _mm_add_ps(_mm_mul_ps(az, s1), _mm_mul_ps(bz, t));
+		__m128 rw = _mm_add_ps(_mm_mul_ps(aw, s1), _mm_mul_ps(bw, t));
+
+		// Normalize, degenerate results become identity like Normalised
+		__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)),
+			_mm_add_ps(_mm_mul_ps(rz, rz), _mm_mul_ps(rw, rw)));
+		__m128 valid = _mm_cmpge_ps(lenSq, epsilon);
+		__m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(lenSq));
+		rx = _mm_and_ps(_mm_mul_ps(rx, invLen), valid);
+		ry = _mm_and_ps(_mm_mul_ps(ry, invLen), valid);
+		rz = _mm_and_ps(_mm_mul_ps(rz, invLen), valid);
+		rw = _mm_or_ps(_mm_and_ps(_mm_mul_ps(rw, invLen), valid),
+			_mm_andnot_ps(valid, one));
+
+		_MM_TRANSPOSE4_PS(rx, ry, rz, rw);
+		_mm_storeu_ps(outRotations[i].v, rx);
+		_mm_storeu_ps(outRotations[i + 1].v, ry);
+		_mm_storeu_ps(outRotations[i + 2].v, rz);
+		_mm_storeu_ps(outRotations[i + 3].v, rw);
+	}
+
+	NlerpBatchScalar(&segments[i], count - i, &outRotations[i]); // Leftovers
+}
+
+#else
+
+void NlerpBatch(const RotationSegment* segments, unsigned int count, Quaternion* outRotations) {
+	NlerpBatchScalar(segments, count, outRotations);
+}
+
+#endif
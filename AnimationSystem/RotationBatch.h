@@ -0,0 +1,25 @@
+#ifndef _H_ROTATIONBATCH_
+#define _H_ROTATIONBATCH_
+
+#include "Quaternion.h"
+
+// Define ROTATION_BATCH_NO_SIMD to always use the scalar loop
+#if !defined(ROTATION_BATCH_NO_SIMD) && (defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define ROTATION_BATCH_SSE
+#endif
+
+// The two keys a linear rotation channel sits between, so the nlerp
+// for many joints can be done together
+struct RotationSegment {
+	Quaternion mStart;
+	Quaternion mEnd;
+	float mT;
+};
+
+// Same result as TrackHelpers::Interpolate for each segment, four
+// segments at a time when SSE is available
+void NlerpBatch(const RotationSegment* segments, unsigned int count, Quaternion* outRotations);
+void NlerpBatchScalar(const RotationSegment* segments, unsigned int count, Quaternion* outRotations);
+
+#endif
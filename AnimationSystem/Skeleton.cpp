@@ -0,0 +1,49 @@
+#include "Skeleton.h"
+
+Skeleton::Skeleton() { }
+
+Skeleton::Skeleton(const Pose& rest, const Pose& bind, const std::vector<std::string>& names) {
+	Set(rest, bind, names);
+}
+
+void Skeleton::Set(const Pose& rest, const Pose& bind, const std::vector<std::string>& names) {
+	mRestPose = rest;
+	mBindPose = bind;
+	mBindPose.ShareHierarchy(mRestPose); // Keep one copy of the parents
+	mJointNames = names;
+	UpdateInverseBindPose();
+}
+
+void Skeleton::UpdateInverseBindPose() {
+	unsigned int size = mBindPose.Size();
+	mInvBindPose.resize(size);
+
+	const std::vector<Transform>& world = mBindPose.GetGlobalTransforms();
+	for (unsigned int i = 0; i < size; ++i) {
+		mInvBindPose[i] = inverse(TransformToMat4(world[i]));
+	}
+}
+
+Pose& Skeleton::GetBindPose() {
+	return mBindPose;
+}
+
+Pose& Skeleton::GetRestPose() {
+	return mRestPose;
+}
+
+std::vector<mat4>& Skeleton::GetInvBindPose() {
+	return mInvBindPose;
+}
+
+std::vector<std::string>& Skeleton::GetJointNames() {
+	return mJointNames;
+}
+
+std::string& Skeleton::GetJointName(unsigned int index) {
+	return mJointNames[index];
+}
+
+unsigned int Skeleton::Size() {
+	return mRestPose.Size();
+}
@@ -0,0 +1,33 @@
+#ifndef _H_SKELETON_
+#define _H_SKELETON_
+
+#include "Pose.h"
+#include "mat4.h"
+#include <vector>
+#include <string>
+
+// Everything the instances of a rig have in common. Poses copied from
+// the rest or bind pose share its hierarchy instead of copying it.
+class Skeleton {
+protected:
+	Pose mRestPose;
+	Pose mBindPose;
+	std::vector<mat4> mInvBindPose;
+	std::vector<std::string> mJointNames;
+protected:
+	void UpdateInverseBindPose();
+public:
+	Skeleton();
+	Skeleton(const Pose& rest, const Pose& bind, const std::vector<std::string>& names);
+
+	void Set(const Pose& rest, const Pose& bind, const std::vector<std::string>& names);
+
+	Pose& GetBindPose();
+	Pose& GetRestPose();
+	std::vector<mat4>& GetInvBindPose();
+	std::vector<std::string>& GetJointNames();
+	std::string& GetJointName(unsigned int index);
+	unsigned int Size();
+};
+
+#endif
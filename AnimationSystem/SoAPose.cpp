@@ -0,0 +1,284 @@
+#include "SoAPose.h"
+#ifdef SOA_POSE_SSE
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+void SoATransforms::Resize(unsigned int paddedSize)
+{
+	for (unsigned int i = 0; i < 3; ++i) {
+		mPosition[i].resize(paddedSize, 0.0f);
+		mScale[i].resize(paddedSize, 1.0f);
+	}
+	for (unsigned int i = 0; i < 3; ++i) {
+		mRotation[i].resize(paddedSize, 0.0f);
+	}
+	mRotation[3].resize(paddedSize, 1.0f);
+}
+
+Transform SoATransforms::Get(unsigned int index) const
+{
+	Transform result;
+	result.position = vec3(mPosition[0][index], mPosition[1][index], mPosition[2][index]);
+	result.rotation = Quaternion(mRotation[0][index], mRotation[1][index],
+		mRotation[2][index], mRotation[3][index]);
+	result.scale = vec3(mScale[0][index], mScale[1][index], mScale[2][index]);
+	return result;
+}
+
+void SoATransforms::Set(unsigned int index, const Transform& transform)
+{
+	for (unsigned int i = 0; i < 3; ++i) {
+		mPosition[i][index] = transform.position.v[i];
+		mScale[i][index] = transform.scale.v[i];
+	}
+	for (unsigned int i = 0; i < 4; ++i) {
+		mRotation[i][index] = transform.rotation.v[i];
+	}
+}
+
+SoAPose::SoAPose()
+{
+	mSize = 0;
+}
+
+SoAPose::SoAPose(Pose& pose)
+{
+	mSize = 0;
+	Set(pose);
+}
+
+void SoAPose::Resize(unsigned int size)
+{
+	unsigned int padded = (size + 3) & ~3u;
+	mLocals.Resize(padded);
+	mGlobals.Resize(padded);
+	mParents.resize(padded, -1);
+	for (unsigned int i = size; i < padded; ++i) {
+		mParents[i] = -1;
+		mLocals.Set(i, Transform());
+	}
+	mSize = size;
+}
+
+unsigned int SoAPose::Size()
+{
+	return mSize;
+}
+
+void SoAPose::Set(Pose& pose)
+{
+	unsigned int size = pose.Size();
+	Resize(size);
+	for (unsigned int i = 0; i < size; ++i) {
+		mParents[i] = pose.GetParent(i);
+		mLocals.Set(i, pose.GetLocalTransform(i));
+	}
+}
+
+void SoAPose::Get(Pose& outPose)
+{
+	outPose.Resize(mSize);
+	for (unsigned int i = 0; i < mSize; ++i) {
+		outPose.SetParent(i, mParents[i]);
+		outPose.SetLocalTransform(i, mLocals.Get(i));
+	}
+}
+
+int SoAPose::GetParent(unsigned int index)
+{
+	return mParents[index];
+}
+
+void SoAPose::SetParent(unsigned int index, int parent)
+{
+	mParents[index] = parent;
+}
+
+Transform SoAPose::GetLocalTransform(unsigned int index)
+{
+	return mLocals.Get(index);
+}
+
+void SoAPose::SetLocalTransform(unsigned int index, const Transform& transform)
+{
+	mLocals.Set(index, transform);
+}
+
+Transform SoAPose::GetGlobalTransform(unsigned int index)
+{
+	return mGlobals.Get(index);
+}
+
+void SoAPose::CombineJoint(unsigned int index)
+{
+	int parent = mParents[index];
+	Transform result = mLocals.Get(index);
+	if (parent >= 0 && parent < (int)index) { // Parent is already done
+		result = Combine(mGlobals.Get(parent), result);
+	}
+	else { // Out of order, walk the chain
+		for (int p = parent; p >= 0; p = mParents[p]) {
+			result = Combine(mLocals.Get(p), result);
+		}
+	}
+	mGlobals.Set(index, result);
+}
+
+#ifdef SOA_POSE_SSE
+
+// The joints in the block are combined with their parents' globals,
+// same math as Combine with a root lane using an identity parent
+void SoAPose::CombineBlock(unsigned int first)
+{
+	const int* parents = &mParents[first];
+	float pp[3][4], pr[4][4], ps[3][4];
+	for (unsigned int lane = 0; lane < 4; ++lane) {
+		int p = parents[lane];
+		for (unsigned int c = 0; c < 3; ++c) {
+			pp[c][lane] = p < 0 ? 0.0f : mGlobals.mPosition[c][p];
+			ps[c][lane] = p < 0 ? 1.0f : mGlobals.mScale[c][p];
+		}
+		for (unsigned int c = 0; c < 4; ++c) {
+			pr[c][lane] = p < 0 ? (c == 3 ? 1.0f : 0.0f) : mGlobals.mRotation[c][p];
+		}
+	}
+	__m128 ax = _mm_loadu_ps(pr[0]), ay = _mm_loadu_ps(pr[1]);
+	__m128 az = _mm_loadu_ps(pr[2]), aw = _mm_loadu_ps(pr[3]);
+	__m128 bx = _mm_loadu_ps(&mLocals.mRotation[0][first]);
+	__m128 by = _mm_loadu_ps(&mLocals.mRotation[1][first]);
+	__m128 bz = _mm_loadu_ps(&mLocals.mRotation[2][first]);
+	__m128 bw = _mm_loadu_ps(&mLocals.mRotation[3][first]);
+
+	// rotation = local * parent
+	__m128 rx = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(ax, bw), _mm_mul_ps(ay, bz)),
+		_mm_mul_ps(az, by)), _mm_mul_ps(aw, bx));
+	__m128 ry = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(ay, bw), _mm_mul_ps(ax, bz)),
+		_mm_mul_ps(az, bx)), _mm_mul_ps(aw, by));
+	__m128 rz = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx)),
+		_mm_mul_ps(az, bw)), _mm_mul_ps(aw, bz));
+	__m128 rw = _mm_add_ps(_mm_sub_ps(_mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(ax, bx)),
+		_mm_add_ps(_mm_mul_ps(ay, by), _mm_mul_ps(az, bz))), _mm_mul_ps(aw, bw));
+	_mm_storeu_ps(&mGlobals.mRotation[0][first], rx);
+	_mm_storeu_ps(&mGlobals.mRotation[1][first], ry);
+	_mm_storeu_ps(&mGlobals.mRotation[2][first], rz);
+	_mm_storeu_ps(&mGlobals.mRotation[3][first], rw);
+
+	// scale = parent scale * local scale
+	__m128 sx = _mm_loadu_ps(ps[0]), sy = _mm_loadu_ps(ps[1]), sz = _mm_loadu_ps(ps[2]);
+	_mm_storeu_ps(&mGlobals.mScale[0][first], _mm_mul_ps(sx, _mm_loadu_ps(&mLocals.mScale[0][first])));
+	_mm_storeu_ps(&mGlobals.mScale[1][first], _mm_mul_ps(sy, _mm_loadu_ps(&mLocals.mScale[1][first])));
+	_mm_storeu_ps(&mGlobals.mScale[2][first], _mm_mul_ps(sz, _mm_loadu_ps(&mLocals.mScale[2][first])));
+
+	// position = parent position + parent rotation * (parent scale * local position)
+	__m128 vx = _mm_mul_ps(sx, _mm_loadu_ps(&mLocals.mPosition[0][first]));
+	__m128 vy = _mm_mul_ps(sy, _mm_loadu_ps(&mLocals.mPosition[1][first]));
+	__m128 vz = _mm_mul_ps(sz, _mm_loadu_ps(&mLocals.mPosition[2][first]));
+	__m128 two = _mm_set1_ps(2.0f);
+	__m128 dot2 = _mm_mul_ps(two, _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, vx),
+		_mm_mul_ps(ay, vy)), _mm_mul_ps(az, vz)));
+	__m128 len = _mm_sub_ps(_mm_mul_ps(aw, aw), _mm_add_ps(_mm_add_ps(
+		_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay)), _mm_mul_ps(az, az)));
+	__m128 w2 = _mm_mul_ps(two, aw);
+	__m128 cx = _mm_sub_ps(_mm_mul_ps(ay, vz), _mm_mul_ps(az, vy));
+	__m128 cy = _mm_sub_ps(_mm_mul_ps(az, vx), _mm_mul_ps(ax, vz));
+	__m128 cz = _mm_sub_ps(_mm_mul_ps(ax, vy), _mm_mul_ps(ay, vx));
+	__m128 px = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, dot2), _mm_mul_ps(vx, len)), _mm_mul_ps(cx, w2));
+	__m128 py = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ay, dot2), _mm_mul_ps(vy, len)), _mm_mul_ps(cy, w2));
+	__m128 pz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(az, dot2), _mm_mul_ps(vz, len)), _mm_mul_ps(cz, w2));
+	_mm_storeu_ps(&mGlobals.mPosition[0][first], _mm_add_ps(_mm_loadu_ps(pp[0]), px));
+	_mm_storeu_ps(&mGlobals.mPosition[1][first], _mm_add_ps(_mm_loadu_ps(pp[1]), py));
+	_mm_storeu_ps(&mGlobals.mPosition[2][first], _mm_add_ps(_mm_loadu_ps(pp[2]), pz));
+}
+
+#else
+
+void SoAPose::CombineBlock(unsigned int first)
+{
+	for (unsigned int i = first; i < first + 4; ++i) {
+		CombineJoint(i);
+	}
+}
+
+#endif
+
+void SoAPose::UpdateGlobalTransforms()
+{
+	unsigned int padded = (unsigned int)mParents.size();
+	for (unsigned int first = 0; first < padded; first += 4) {
+		bool parentsDone = true;
+		for (unsigned int lane = 0; lane < 4; ++lane) {
+			parentsDone = parentsDone && mParents[first + lane] < (int)first;
+		}
+		if (parentsDone) {
+			CombineBlock(first);
+		}
+		else { // A parent inside the block or after it, one at a time
+			for (unsigned int i = first; i < first + 4; ++i) {
+				CombineJoint(i);
+			}
+		}
+	}
+}
+
+void SoAPose::GetMatrixPalette(std::vector<mat4>& out)
+{
+	if (out.size() != mSize) {
+		out.resize(mSize);
+	}
+	UpdateGlobalTransforms();
+
+	unsigned int i = 0;
+#ifdef SOA_POSE_SSE
+	const __m128 two = _mm_set1_ps(2.0f);
+	for (; i + 4 <= mSize; i += 4) {
+		__m128 x = _mm_loadu_ps(&mGlobals.mRotation[0][i]);
+		__m128 y = _mm_loadu_ps(&mGlobals.mRotation[1][i]);
+		__m128 z = _mm_loadu_ps(&mGlobals.mRotation[2][i]);
+		__m128 w = _mm_loadu_ps(&mGlobals.mRotation[3][i]);
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y);
+		__m128 zz = _mm_mul_ps(z, z), ww = _mm_mul_ps(w, w);
+		__m128 xy = _mm_mul_ps(two, _mm_mul_ps(x, y));
+		__m128 xz = _mm_mul_ps(two, _mm_mul_ps(x, z));
+		__m128 yz = _mm_mul_ps(two, _mm_mul_ps(y, z));
+		__m128 wx = _mm_mul_ps(two, _mm_mul_ps(w, x));
+		__m128 wy = _mm_mul_ps(two, _mm_mul_ps(w, y));
+		__m128 wz = _mm_mul_ps(two, _mm_mul_ps(w, z));
+		__m128 sx = _mm_loadu_ps(&mGlobals.mScale[0][i]);
+		__m128 sy = _mm_loadu_ps(&mGlobals.mScale[1][i]);
+		__m128 sz = _mm_loadu_ps(&mGlobals.mScale[2][i]);
+
+		// Rotated and scaled basis vectors, as TransformToMat4 builds them
+		__m128 col[16];
+		col[0] = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(ww, xx), _mm_add_ps(yy, zz)), sx);
+		col[1] = _mm_mul_ps(_mm_add_ps(xy, wz), sx);
+		col[2] = _mm_mul_ps(_mm_sub_ps(xz, wy), sx);
+		col[3] = _mm_setzero_ps();
+		col[4] = _mm_mul_ps(_mm_sub_ps(xy, wz), sy);
+		col[5] = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(ww, yy), _mm_add_ps(xx, zz)), sy);
+		col[6] = _mm_mul_ps(_mm_add_ps(yz, wx), sy);
+		col[7] = _mm_setzero_ps();
+		col[8] = _mm_mul_ps(_mm_add_ps(xz, wy), sz);
+		col[9] = _mm_mul_ps(_mm_sub_ps(yz, wx), sz);
+		col[10] = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(ww, zz), _mm_add_ps(xx, yy)), sz);
+		col[11] = _mm_setzero_ps();
+		col[12] = _mm_loadu_ps(&mGlobals.mPosition[0][i]);
+		col[13] = _mm_loadu_ps(&mGlobals.mPosition[1][i]);
+		col[14] = _mm_loadu_ps(&mGlobals.mPosition[2][i]);
+		col[15] = _mm_set1_ps(1.0f);
+
+		// Each register holds one element of four matrices
+		for (unsigned int e = 0; e < 16; e += 4) {
+			__m128 r0 = col[e], r1 = col[e + 1], r2 = col[e + 2], r3 = col[e + 3];
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(&out[i].v[e], r0);
+			_mm_storeu_ps(&out[i + 1].v[e], r1);
+			_mm_storeu_ps(&out[i + 2].v[e], r2);
+			_mm_storeu_ps(&out[i + 3].v[e], r3);
+		}
+	}
+#endif
+	for (; i < mSize; ++i) { // Leftovers
+		out[i] = TransformToMat4(mGlobals.Get(i));
+	}
+}
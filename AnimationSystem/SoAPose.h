@@ -0,0 +1,57 @@
+#ifndef _H_SOAPOSE_
+#define _H_SOAPOSE_
+
+#include "Pose.h"
+#include "mat4.h"
+#include <vector>
+
+// Define SOA_POSE_NO_SIMD to always use the scalar loops
+#if !defined(SOA_POSE_NO_SIMD) && (defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define SOA_POSE_SSE
+#endif
+
+// One contiguous array per transform component, padded with identity
+// transforms to a multiple of four joints so whole blocks can be loaded
+struct SoATransforms {
+	std::vector<float> mPosition[3];
+	std::vector<float> mRotation[4];
+	std::vector<float> mScale[3];
+
+	void Resize(unsigned int paddedSize);
+	Transform Get(unsigned int index) const;
+	void Set(unsigned int index, const Transform& transform);
+};
+
+// A pose laid out for SIMD. Global transforms and the matrix palette are
+// built four joints at a time, a block whose parents all come before it
+// is combined in one go. Convert to and from Pose at the boundaries.
+class SoAPose {
+protected:
+	SoATransforms mLocals;
+	SoATransforms mGlobals;
+	std::vector<int> mParents; // Padding joints are roots
+	unsigned int mSize;
+protected:
+	void CombineJoint(unsigned int index);
+	void CombineBlock(unsigned int first);
+public:
+	SoAPose();
+	SoAPose(Pose& pose);
+	void Resize(unsigned int size);
+	unsigned int Size();
+
+	void Set(Pose& pose);
+	void Get(Pose& outPose);
+
+	int GetParent(unsigned int index);
+	void SetParent(unsigned int index, int parent);
+	Transform GetLocalTransform(unsigned int index);
+	void SetLocalTransform(unsigned int index, const Transform& transform);
+
+	void UpdateGlobalTransforms();
+	Transform GetGlobalTransform(unsigned int index); // From the last update
+	void GetMatrixPalette(std::vector<mat4>& out);
+};
+
+#endif
@@ -1,100 +1,408 @@
 #include "Track.h"
+#include "TrackHelpers.h"
 #include <cmath>
-
-template Track<float, 1>;
-template Track<vec3, 3>;
-template Track<Quaternion, 4>;
-
-namespace TrackHelpers {
-	// linearly interpolate functions
-	inline float Interpolate(float a, float b, float t) {
-		return a + (b - a) * t;
+#include <cstring>
+#ifdef TRACK_BATCH_SSE
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+template class Track<float, 1>;
+template class Track<vec3, 3>;
+template class Track<Quaternion, 4>;
+
+// Interpolates count samples between a and b into out, each value is the
+// same as TrackHelpers::Interpolate(a, b, ts[k])
+namespace BatchHelpers {
+#ifdef TRACK_BATCH_SSE
+	void InterpolateRun(float a, float b, const float* ts, unsigned int count, float* out) {
+		__m128 va = _mm_set1_ps(a);
+		__m128 vd = _mm_set1_ps(b - a);
+		unsigned int k = 0;
+		for (; k + 4 <= count; k += 4) {
+			_mm_storeu_ps(&out[k], _mm_add_ps(va, _mm_mul_ps(vd, _mm_loadu_ps(&ts[k]))));
+		}
+		for (; k < count; ++k) {
+			out[k] = TrackHelpers::Interpolate(a, b, ts[k]);
+		}
 	}
 
-	inline vec3 Interpolate(const vec3& a, const vec3& b, float t) {
-		return Lerp(a, b, t);
-	}
-	inline Quaternion Interpolate(const Quaternion& a, const Quaternion& b,
-		float t) {
-		Quaternion result = Mix(a, b, t);
-		if (Dot(a, b) < 0) { // Neighborhood
-			result = Mix(a, -b, t);
+	void InterpolateRun(const vec3& a, const vec3& b, const float* ts, unsigned int count, vec3* out) {
+		static_assert(sizeof(vec3) == 3 * sizeof(float), "vec3 must be tightly packed");
+		vec3 d = b - a;
+		// Four samples are twelve floats, three registers of xyzx yzxy zxyz
+		__m128 a0 = _mm_setr_ps(a.x, a.y, a.z, a.x);
+		__m128 a1 = _mm_setr_ps(a.y, a.z, a.x, a.y);
+		__m128 a2 = _mm_setr_ps(a.z, a.x, a.y, a.z);
+		__m128 d0 = _mm_setr_ps(d.x, d.y, d.z, d.x);
+		__m128 d1 = _mm_setr_ps(d.y, d.z, d.x, d.y);
+		__m128 d2 = _mm_setr_ps(d.z, d.x, d.y, d.z);
+		unsigned int k = 0;
+		for (; k + 4 <= count; k += 4) {
+			__m128 t = _mm_loadu_ps(&ts[k]);
+			__m128 t0 = _mm_shuffle_ps(t, t, _MM_SHUFFLE(1, 0, 0, 0));
+			__m128 t1 = _mm_shuffle_ps(t, t, _MM_SHUFFLE(2, 2, 1, 1));
+			__m128 t2 = _mm_shuffle_ps(t, t, _MM_SHUFFLE(3, 3, 3, 2));
+			float* f = out[k].v;
+			_mm_storeu_ps(f, _mm_add_ps(a0, _mm_mul_ps(d0, t0)));
+			_mm_storeu_ps(f + 4, _mm_add_ps(a1, _mm_mul_ps(d1, t1)));
+			_mm_storeu_ps(f + 8, _mm_add_ps(a2, _mm_mul_ps(d2, t2)));
+		}
+		for (; k < count; ++k) {
+			out[k] = TrackHelpers::Interpolate(a, b, ts[k]);
 		}
-		return Normalised(result); //NLerp, not slerp
 	}
 
-	inline float AdjustHermiteResult(float f) {
-		return f;
-	}
-	inline vec3 AdjustHermiteResult(const vec3& v) {
-		return v;
-	}
-	inline Quaternion AdjustHermiteResult(const Quaternion& q) {
-		return Normalised(q);
+	void InterpolateRun(const Quaternion& a, const Quaternion& b, const float* ts, unsigned int count, Quaternion* out) {
+		Quaternion end = b;
+		TrackHelpers::Neighborhood(a, end); // Once for the whole run
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 epsilon = _mm_set1_ps(QUAT_EPSILON);
+		unsigned int k = 0;
+		for (; k + 4 <= count; k += 4) {
+			// One component of four samples per register, as Mix then
+			// Normalised compute it
+			__m128 t = _mm_loadu_ps(&ts[k]);
+			__m128 s = _mm_sub_ps(one, t);
+			__m128 x = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.x), s), _mm_mul_ps(_mm_set1_ps(end.x), t));
+			__m128 y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.y), s), _mm_mul_ps(_mm_set1_ps(end.y), t));
+			__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.z), s), _mm_mul_ps(_mm_set1_ps(end.z), t));
+			__m128 w = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.w), s), _mm_mul_ps(_mm_set1_ps(end.w), t));
+			__m128 lenSq = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x),
+				_mm_mul_ps(y, y)), _mm_mul_ps(z, z)), _mm_mul_ps(w, w));
+			__m128 valid = _mm_cmpge_ps(lenSq, epsilon);
+			__m128 invLen = _mm_div_ps(one, _mm_sqrt_ps(lenSq));
+			x = _mm_and_ps(_mm_mul_ps(x, invLen), valid);
+			y = _mm_and_ps(_mm_mul_ps(y, invLen), valid);
+			z = _mm_and_ps(_mm_mul_ps(z, invLen), valid);
+			w = _mm_or_ps(_mm_and_ps(_mm_mul_ps(w, invLen), valid), _mm_andnot_ps(valid, one));
+			_MM_TRANSPOSE4_PS(x, y, z, w);
+			_mm_storeu_ps(out[k].v, x);
+			_mm_storeu_ps(out[k + 1].v, y);
+			_mm_storeu_ps(out[k + 2].v, z);
+			_mm_storeu_ps(out[k + 3].v, w);
+		}
+		for (; k < count; ++k) {
+			out[k] = TrackHelpers::Interpolate(a, b, ts[k]);
+		}
 	}
-	inline void Neighborhood(const float& a, float& b) {}
-	inline void Neighborhood(const vec3& a, vec3& b) {}
-	inline void Neighborhood(const Quaternion& a, Quaternion& b) {
-		if (Dot(a, b) < 0) {
-			b = -b;
+#else
+	template<typename T>
+	void InterpolateRun(const T& a, const T& b, const float* ts, unsigned int count, T* out) {
+		for (unsigned int k = 0; k < count; ++k) {
+			out[k] = TrackHelpers::Interpolate(a, b, ts[k]);
 		}
 	}
-}; 
+#endif
+}
 
 template<typename T, int N>
 Track<T, N>::Track() {
 	mInterpolation = Interpolation::Linear;
+	mSamplesPerSecond = 0.0f;
 }
 
 template<typename T, int N>
 float Track<T, N>::GetStartTime() {
-	return mFrames[0].mTime;
+	return mTimes[0];
 }
 
 template<typename T, int N>
 float Track<T, N>::GetEndTime() {
-	return mFrames[mFrames.size() - 1].mTime;
+	return mTimes[mTimes.size() - 1];
 }
 
 
 template<typename T, int N>
 T Track<T, N>::Sample(float time, bool looping) {
+	return Sample(time, looping, mCursor);
+}
+
+template<typename T, int N>
+T Track<T, N>::Sample(float time, bool looping, TrackCursor& cursor) const {
 	if (mInterpolation == Interpolation::Constant) {
-		return SampleConstant(time, looping);
+		return SampleConstant(time, looping, cursor);
 	}
 	else if (mInterpolation == Interpolation::Linear) {
-		return SampleLinear(time, looping);
+		return SampleLinear(time, looping, cursor);
+	}
+	return SampleCubic(time, looping, cursor);
+}
+
+template<typename T, int N>
+template<Interpolation I>
+T Track<T, N>::SampleAs(float time, bool looping) {
+	return SampleAs<I>(time, looping, mCursor);
+}
+
+template<typename T, int N>
+template<Interpolation I>
+T Track<T, N>::SampleAs(float time, bool looping, TrackCursor& cursor) const {
+	// I is known when compiling, only one of these branches is kept
+	if (I == Interpolation::Constant) {
+		return SampleConstant(time, looping, cursor);
+	}
+	else if (I == Interpolation::Linear) {
+		return SampleLinear(time, looping, cursor);
+	}
+	return SampleCubic(time, looping, cursor);
+}
+
+template float Track<float, 1>::SampleAs<Interpolation::Constant>(float, bool);
+template float Track<float, 1>::SampleAs<Interpolation::Linear>(float, bool);
+template float Track<float, 1>::SampleAs<Interpolation::Cubic>(float, bool);
+template vec3 Track<vec3, 3>::SampleAs<Interpolation::Constant>(float, bool);
+template vec3 Track<vec3, 3>::SampleAs<Interpolation::Linear>(float, bool);
+template vec3 Track<vec3, 3>::SampleAs<Interpolation::Cubic>(float, bool);
+template Quaternion Track<Quaternion, 4>::SampleAs<Interpolation::Constant>(float, bool);
+template Quaternion Track<Quaternion, 4>::SampleAs<Interpolation::Linear>(float, bool);
+template Quaternion Track<Quaternion, 4>::SampleAs<Interpolation::Cubic>(float, bool);
+template float Track<float, 1>::SampleAs<Interpolation::Constant>(float, bool, TrackCursor&) const;
+template float Track<float, 1>::SampleAs<Interpolation::Linear>(float, bool, TrackCursor&) const;
+template float Track<float, 1>::SampleAs<Interpolation::Cubic>(float, bool, TrackCursor&) const;
+template vec3 Track<vec3, 3>::SampleAs<Interpolation::Constant>(float, bool, TrackCursor&) const;
+template vec3 Track<vec3, 3>::SampleAs<Interpolation::Linear>(float, bool, TrackCursor&) const;
+template vec3 Track<vec3, 3>::SampleAs<Interpolation::Cubic>(float, bool, TrackCursor&) const;
+template Quaternion Track<Quaternion, 4>::SampleAs<Interpolation::Constant>(float, bool, TrackCursor&) const;
+template Quaternion Track<Quaternion, 4>::SampleAs<Interpolation::Linear>(float, bool, TrackCursor&) const;
+template Quaternion Track<Quaternion, 4>::SampleAs<Interpolation::Cubic>(float, bool, TrackCursor&) const;
+
+template<typename T, int N>
+void Track<T, N>::SampleBatch(const float* times, unsigned int count, T* outValues, bool looping) const {
+	TrackCursor cursor; // Leaves mCursor alone, playback keeps its place
+	unsigned int size = (unsigned int)mTimes.size();
+	float ts[TRACK_BATCH_RUN];
+
+	unsigned int i = 0;
+	while (i < count) {
+		// Wrap or clamp the first time of the run, the rest of the run
+		// is moved by the same amount
+		float trackTime = AdjustTimeToFitTrack(times[i], looping);
+		int frame = FrameIndex(trackTime, looping, cursor);
+		if (frame < 0 || frame >= (int)size - 1 || mTimes[frame + 1] - mTimes[frame] <= 0.0f) {
+			outValues[i] = Sample(times[i], looping, cursor);
+			++i;
+			continue;
+		}
+		float offset = trackTime - times[i];
+		bool clamped = !looping && offset != 0.0f;
+		float thisTime = mTimes[frame];
+		float frameDelta = mTimes[frame + 1] - thisTime;
+		float endTime = mTimes[size - 1];
+
+		// Every sample that falls between this pair of keys
+		unsigned int run = 0;
+		while (i + run < count && run < TRACK_BATCH_RUN) {
+			float time = run == 0 ? trackTime : times[i + run] + offset;
+			if (run > 0 && (clamped || (looping && time >= endTime))) {
+				break; // Has to be wrapped or clamped again
+			}
+			float t = 0.0f;
+			if (mInterpolation == Interpolation::Cubic && mCoefficients.size() > 0) {
+				t = (time - thisTime) * mInvFrameDeltas[frame];
+			}
+			else {
+				t = (time - thisTime) / frameDelta;
+			}
+			bool inside = mInterpolation == Interpolation::Constant ?
+				t >= 0.0f && t < 1.0f : t >= 0.0f && t <= 1.0f;
+			if (!inside) {
+				break;
+			}
+			ts[run++] = t;
+		}
+		if (run == 0) {
+			outValues[i] = Sample(times[i], looping, cursor);
+			++i;
+			continue;
+		}
+
+		if (mInterpolation == Interpolation::Linear) {
+			BatchHelpers::InterpolateRun(Cast(&mValues[frame * N]),
+				Cast(&mValues[(frame + 1) * N]), ts, run, &outValues[i]);
+		}
+		else if (mInterpolation == Interpolation::Constant) {
+			T value = Cast(&mValues[frame * N]);
+			for (unsigned int k = 0; k < run; ++k) {
+				outValues[i + k] = value;
+			}
+		}
+		else {
+			for (unsigned int k = 0; k < run; ++k) {
+				outValues[i + k] = EvaluateCubic(frame, ts[k]);
+			}
+		}
+		i += run;
 	}
-	return SampleCubic(time, looping);
 }
 
 template<typename T, int N>
-Frame<N>& Track<T, N>::operator[](unsigned int index) {
-	return mFrames[index];
+Frame<N> Track<T, N>::GetFrame(unsigned int index) {
+	Frame<N> result;
+	result.mTime = mTimes[index];
+	memcpy(result.mValue, &mValues[index * N], N * sizeof(float));
+	if (mInterpolation == Interpolation::Cubic) {
+		memcpy(result.mIn, &mInTangents[index * N], N * sizeof(float));
+		memcpy(result.mOut, &mOutTangents[index * N], N * sizeof(float));
+	}
+	else {
+		memset(result.mIn, 0, N * sizeof(float));
+		memset(result.mOut, 0, N * sizeof(float));
+	}
+	return result;
+}
+
+template<typename T, int N>
+T Track<T, N>::GetValue(unsigned int index) const {
+	return Cast(&mValues[index * N]);
+}
+
+template<typename T, int N>
+void Track<T, N>::SetFrame(unsigned int index, const Frame<N>& frame) {
+	mTimes[index] = frame.mTime;
+	memcpy(&mValues[index * N], frame.mValue, N * sizeof(float));
+	if (mInterpolation == Interpolation::Cubic) { // Otherwise dropped
+		memcpy(&mInTangents[index * N], frame.mIn, N * sizeof(float));
+		memcpy(&mOutTangents[index * N], frame.mOut, N * sizeof(float));
+	}
+	ClearCubicCoefficients(); // Built for the old keys
 }
 
 template<typename T, int N>
 void Track<T, N>::Resize(unsigned int size) {
-	mFrames.resize(size);
+	mTimes.resize(size);
+	mValues.resize(size * N);
+	if (mInterpolation == Interpolation::Cubic) {
+		mInTangents.resize(size * N);
+		mOutTangents.resize(size * N);
+	}
+	ClearIndexLookupTable(); // Built for the old keys
+	ClearCubicCoefficients();
+}
+
+template<typename T, int N>
+unsigned int Track<T, N>::Size() const {
+	return (unsigned int)mTimes.size();
 }
 
 template<typename T, int N>
-unsigned int Track<T, N>::Size() {
-	return mFrames.size();
+unsigned int Track<T, N>::GetKeyMemorySize() {
+	return (unsigned int)((mTimes.size() + mValues.size() +
+		mInTangents.size() + mOutTangents.size()) * sizeof(float));
 }
 
 template<typename T, int N>
-Interpolation Track<T, N>::GetInterpolation() {
+Interpolation Track<T, N>::GetInterpolation() const {
 	return mInterpolation;
 }
 
 template<typename T, int N> 
 void Track<T, N>::SetInterpolation(Interpolation interpolation) {
 	mInterpolation = interpolation;
+	if (interpolation == Interpolation::Cubic) {
+		mInTangents.resize(mValues.size());
+		mOutTangents.resize(mValues.size());
+	}
+	else { // Only cubic tracks need tangents
+		ClearCubicCoefficients();
+		mInTangents.clear();
+		mInTangents.shrink_to_fit();
+		mOutTangents.clear();
+		mOutTangents.shrink_to_fit();
+	}
+}
+
+template<typename T, int N>
+void Track<T, N>::UpdateIndexLookupTable(float samplesPerSecond) {
+	ClearIndexLookupTable();
+	int numFrames = (int)mTimes.size();
+	if (numFrames <= 1 || samplesPerSecond <= 0.0f) {
+		return;
+	}
+	float startTime = GetStartTime();
+	float duration = GetEndTime() - startTime;
+	if (duration <= 0.0f) {
+		return;
+	}
+
+	unsigned int numSamples = 1 + (unsigned int)(duration * samplesPerSecond);
+	mSampledFrames.resize(numSamples);
+	mSamplesPerSecond = samplesPerSecond;
+
+	// Each bucket stores the last key at or before the start of the bucket
+	int frame = 0;
+	for (unsigned int i = 0; i < numSamples; ++i) {
+		float time = startTime + (float)i / samplesPerSecond;
+		while (frame < numFrames - 2 && time >= mTimes[frame + 1]) {
+			++frame;
+		}
+		mSampledFrames[i] = (unsigned int)frame;
+	}
+}
+
+template<typename T, int N>
+void Track<T, N>::ClearIndexLookupTable() {
+	mSampledFrames.clear();
+	mSampledFrames.shrink_to_fit();
+	mSamplesPerSecond = 0.0f;
+}
+
+template<typename T, int N>
+unsigned int Track<T, N>::GetIndexLookupTableSize() {
+	return (unsigned int)(mSampledFrames.size() * sizeof(unsigned int));
+}
+
+// Expands every Hermite segment into polynomial form once, so sampling
+// does not have to rebuild the basis and scale the tangents each time
+template<typename T, int N>
+void Track<T, N>::UpdateCubicCoefficients() {
+	ClearCubicCoefficients();
+	unsigned int size = (unsigned int)mTimes.size();
+	if (mInterpolation != Interpolation::Cubic || size <= 1) {
+		return;
+	}
+	mCoefficients.resize((size - 1) * 4 * N);
+	mInvFrameDeltas.resize(size - 1);
+
+	for (unsigned int i = 0; i < size - 1; ++i) {
+		float frameDelta = mTimes[i + 1] - mTimes[i];
+		mInvFrameDeltas[i] = frameDelta > 0.0f ? 1.0f / frameDelta : 0.0f;
+
+		T p1 = Cast(&mValues[i * N]);
+		T p2 = Cast(&mValues[(i + 1) * N]);
+		TrackHelpers::Neighborhood(p1, p2);
+		T s1;
+		memcpy(&s1, &mOutTangents[i * N], N * sizeof(float));
+		s1 = s1 * frameDelta;
+		T s2;
+		memcpy(&s2, &mInTangents[(i + 1) * N], N * sizeof(float));
+		s2 = s2 * frameDelta;
+
+		T a = p1 * 2.0f - p2 * 2.0f + s1 + s2;
+		T b = p2 * 3.0f - p1 * 3.0f - s1 * 2.0f - s2;
+		float* coefficients = &mCoefficients[i * 4 * N];
+		memcpy(coefficients, &a, N * sizeof(float));
+		memcpy(coefficients + N, &b, N * sizeof(float));
+		memcpy(coefficients + 2 * N, &s1, N * sizeof(float));
+		memcpy(coefficients + 3 * N, &p1, N * sizeof(float));
+	}
+}
+
+template<typename T, int N>
+void Track<T, N>::ClearCubicCoefficients() {
+	mCoefficients.clear();
+	mCoefficients.shrink_to_fit();
+	mInvFrameDeltas.clear();
+	mInvFrameDeltas.shrink_to_fit();
+}
+
+template<typename T, int N>
+unsigned int Track<T, N>::GetCubicCoefficientsSize() {
+	return (unsigned int)((mCoefficients.size() + mInvFrameDeltas.size()) * sizeof(float));
 }
 
 template <typename T, int N>
-T Track<T, N>::Hermite(float t, const T& p1, const T& s1, const T& _p2, const T& s2) {
+T Track<T, N>::Hermite(float t, const T& p1, const T& s1, const T& _p2, const T& s2) const {
 
 	float tt = t * t;
 	float ttt = tt * t;
@@ -113,56 +421,120 @@ T Track<T, N>::Hermite(float t, const T& p1, const T& s1, const T& _p2, const T&
 
 
 template<typename T, int N>
-
-int Track<T, N>::FrameIndex(float time, bool looping) {
-	unsigned int size = (unsigned int)mFrames.size();
+int Track<T, N>::FrameIndex(float time, bool looping, TrackCursor& cursor) const {
+	unsigned int size = (unsigned int)mTimes.size();
 	if (size <= 1) {
 		return -1;
 	}
 
 	if (looping) {
-		float startTime = mFrames[0].mTime;
-		float endTime = mFrames[size - 1].mTime;
+		float startTime = mTimes[0];
+		float endTime = mTimes[size - 1];
 		float duration = endTime - startTime;
 		
-		time = fmodf(time - startTime, endTime - startTime);
-		if (time < 0.0f) {
-			time += endTime - startTime;
+		if (time < startTime || time >= endTime) { // Clips pass times in range
+			time = fmodf(time - startTime, endTime - startTime);
+			if (time < 0.0f) {
+				time += endTime - startTime;
+			}
+			time = time + startTime;
 		}
-		time = time + startTime;
 	}
 	else {
-		if (time <= mFrames[0].mTime) {
+		if (time <= mTimes[0]) {
+			cursor.mFrame = 0;
 			return 0;
 		}
-		if (time >= mFrames[size - 2].mTime) {
+		if (time >= mTimes[size - 2]) {
+			cursor.mFrame = (int)size - 2;
 			return (int)size - 2;
 		}
 	}
-	for (int i = (int)size - 1; i >= 0; --i) {
-		if (time >= mFrames[i].mTime) {
-			return i;
+
+	// Walk from the last sampled key, this is the common case for playback
+	int last = (int)size - 2; // Last key that starts a segment
+	int frame = cursor.mFrame;
+	if (frame >= 0 && frame <= last) {
+		int steps = 0;
+		while (frame < last && time >= mTimes[frame + 1] &&
+			steps < TRACK_CURSOR_MAX_STEPS) {
+			++frame;
+			++steps;
+		}
+		while (frame > 0 && time < mTimes[frame] &&
+			steps < TRACK_CURSOR_MAX_STEPS) {
+			--frame;
+			++steps;
+		}
+		if ((frame == 0 || time >= mTimes[frame]) &&
+			(frame == last || time < mTimes[frame + 1])) {
+			cursor.mFrame = frame;
+			return frame;
 		}
 	}
-	// Invalid code,
-	return -1;
+
+	// Seek or loop wrap, use the lookup table if there is one
+	if (mSampledFrames.size() > 0) {
+		cursor.mFrame = LookupFrame(time);
+	}
+	else {
+		cursor.mFrame = FindFrame(time);
+	}
+	return cursor.mFrame;
 } // End of FrameIndex
 
 template<typename T, int N>
-float Track<T, N>::AdjustTimeToFitTrack(float time, bool looping) {
-	unsigned int size = (unsigned int)mFrames.size();
+int Track<T, N>::LookupFrame(float time) const {
+	int last = (int)mTimes.size() - 2;
+	float bucket = (time - mTimes[0]) * mSamplesPerSecond;
+	unsigned int index = bucket <= 0.0f ? 0 : (unsigned int)bucket;
+	if (index >= mSampledFrames.size()) {
+		index = (unsigned int)mSampledFrames.size() - 1;
+	}
+
+	// The bucket gives the key at its start, probe the few keys inside it
+	int frame = (int)mSampledFrames[index];
+	while (frame < last && time >= mTimes[frame + 1]) {
+		++frame;
+	}
+	while (frame > 0 && time < mTimes[frame]) {
+		--frame;
+	}
+	return frame;
+}
+
+template<typename T, int N>
+int Track<T, N>::FindFrame(float time) const {
+	// Binary search for the last key at or before time
+	int low = 0;
+	int high = (int)mTimes.size() - 2;
+	while (low < high) {
+		int mid = (low + high + 1) / 2;
+		if (time >= mTimes[mid]) {
+			low = mid;
+		}
+		else {
+			high = mid - 1;
+		}
+	}
+	return low;
+}
+
+template<typename T, int N>
+float Track<T, N>::AdjustTimeToFitTrack(float time, bool looping) const {
+	unsigned int size = (unsigned int)mTimes.size();
 	if (size <= 1) {
 		return 0.0f;
 	}
 
-	float startTime = mFrames[0].mTime;
-	float endTime = mFrames[size - 1].mTime;
+	float startTime = mTimes[0];
+	float endTime = mTimes[size - 1];
 	float duration = endTime - startTime;
 	if (duration <= 0.0f) {
 		return 0.0f;
 	}
 
-	if (looping) {
+	if (looping && (time < startTime || time >= endTime)) {
 		time = fmodf(time - startTime,
 			endTime - startTime);
 		if (time < 0.0f) {
@@ -172,10 +544,10 @@ float Track<T, N>::AdjustTimeToFitTrack(float time, bool looping) {
 	}
 
 	else {
-		if (time <= mFrames[0].mTime) {
+		if (time <= mTimes[0]) {
 			time = startTime;
 		}
-		if (time >= mFrames[size - 1].mTime) {
+		if (time >= mTimes[size - 1]) {
 			time = endTime;
 		}
 	}
@@ -183,73 +555,294 @@ float Track<T, N>::AdjustTimeToFitTrack(float time, bool looping) {
 }
 
 
-template<> float Track<float, 1>::Cast(float* value) {
+template<> float Track<float, 1>::Cast(const float* value) const {
 	return value[0];
 }
 
-template<> vec3 Track<vec3, 3>::Cast(float* value) {
+template<> vec3 Track<vec3, 3>::Cast(const float* value) const {
 	return vec3(value[0], value[1], value[2]);
 }
 
-template<> Quaternion Track<Quaternion, 4>::Cast(float* value) {
+template<> Quaternion Track<Quaternion, 4>::Cast(const float* value) const {
 	Quaternion r = Quaternion(value[0], value[1], value[2], value[3]);
 	return Quaternion(r);
 }
 
 template<typename T, int N>
-T Track<T, N>::SampleConstant(float t, bool loop) {
-	int frame = FrameIndex(t, loop);
-	if (frame < 0 || frame >= (int)mFrames.size()) {
+T Track<T, N>::SampleConstant(float t, bool loop, TrackCursor& cursor) const {
+	int frame = FrameIndex(t, loop, cursor);
+	if (frame < 0 || frame >= (int)mTimes.size()) {
 		return T();
 	}
-	return Cast(&mFrames[frame].mValue[0]);
+	return Cast(&mValues[frame * N]);
 }
 
 template<typename T, int N>
-T Track<T, N>::SampleLinear(float time, bool looping) {
-	int thisFrame = FrameIndex(time, looping);
-	if (thisFrame < 0 || thisFrame >= mFrames.size() - 1) {
+T Track<T, N>::SampleLinear(float time, bool looping, TrackCursor& cursor) const {
+	int thisFrame = FrameIndex(time, looping, cursor);
+	if (thisFrame < 0 || thisFrame >= mTimes.size() - 1) {
 		return T();
 	}
 	int nextFrame = thisFrame + 1;
 	float trackTime = AdjustTimeToFitTrack(time, looping);
-	float thisTime = mFrames[thisFrame].mTime;
-	float frameDelta = mFrames[nextFrame].mTime  thisTime;
+	float thisTime = mTimes[thisFrame];
+	float frameDelta = mTimes[nextFrame] - thisTime;
 	if (frameDelta <= 0.0f) {
 		return T();
 	}
 	float t = (trackTime - thisTime) / frameDelta;
-	T start = Cast(&mFrames[thisFrame].mValue[0]);
-	T end = Cast(&mFrames[nextFrame].mValue[0]);
+	T start = Cast(&mValues[thisFrame * N]);
+	T end = Cast(&mValues[nextFrame * N]);
 	return TrackHelpers::Interpolate(start, end, t);
 }
 
 
 template<typename T, int N>
-T Track<T, N>::SampleCubic(float time, bool looping) {
-	int thisFrame = FrameIndex(time, looping);
-	if (thisFrame < 0 || thisFrame >= mFrames.size() - 1) {
+T Track<T, N>::SampleCubic(float time, bool looping, TrackCursor& cursor) const {
+	int thisFrame = FrameIndex(time, looping, cursor);
+	if (thisFrame < 0 || thisFrame >= mTimes.size() - 1) {
 		return T();
 	}
 	int nextFrame = thisFrame + 1;
 	float trackTime = AdjustTimeToFitTrack(time, looping);
-	float thisTime = mFrames[thisFrame].mTime;
-	float frameDelta = mFrames[nextFrame].mTime - thisTime;
-	if (frameDelta <= 0.0f) {
-		return T();
+	float thisTime = mTimes[thisFrame];
+
+	float t = 0.0f;
+	if (mCoefficients.size() > 0) {
+		float invFrameDelta = mInvFrameDeltas[thisFrame];
+		if (invFrameDelta <= 0.0f) {
+			return T();
+		}
+		t = (trackTime - thisTime) * invFrameDelta;
+	}
+	else {
+		float frameDelta = mTimes[nextFrame] - thisTime;
+		if (frameDelta <= 0.0f) {
+			return T();
+		}
+		t = (trackTime - thisTime) / frameDelta;
 	}
+	return EvaluateCubic(thisFrame, t);
+}
 
-	float t = (trackTime - thisTime) / frameDelta;
+template<typename T, int N>
+T Track<T, N>::EvaluateCubic(int frame, float t) const {
+	if (mCoefficients.size() > 0) {
+		const float* c = &mCoefficients[frame * 4 * N];
+		float value[N];
+		for (int i = 0; i < N; ++i) { // Horner's rule
+			value[i] = ((c[i] * t + c[N + i]) * t + c[2 * N + i]) * t + c[3 * N + i];
+		}
+		return TrackHelpers::AdjustHermiteResult(Cast(value));
+	}
 
+	int nextFrame = frame + 1;
+	float frameDelta = mTimes[nextFrame] - mTimes[frame];
 	size_t fltSize = sizeof(float);
-	T point1 = Cast(&mFrames[thisFrame].mValue[0]);
-	T slope1;// = mFrames[thisFrame].mOut * frameDelta;
-	memcpy(&slope1, mFrames[thisFrame].mOut, N * fltSize);
+	T point1 = Cast(&mValues[frame * N]);
+	T slope1;
+	memcpy(&slope1, &mOutTangents[frame * N], N * fltSize);
 	slope1 = slope1 * frameDelta;
-	T point2 = Cast(&mFrames[nextFrame].mValue[0]);
-	T slope2;// = mFrames[nextFrame].mIn[0] * frameDelta;
-	memcpy(&slope2, mFrames[nextFrame].mIn, N * fltSize);
+	T point2 = Cast(&mValues[nextFrame * N]);
+	T slope2;
+	memcpy(&slope2, &mInTangents[nextFrame * N], N * fltSize);
 	slope2 = slope2 * frameDelta;
 
 	return Hermite(t, point1, slope1, point2, slope2);
-}
\ No newline at end of file
+}
+
+// Finds the segment time falls in and how far along it time is, so tracks
+// with the same key times only have to search once. outT is negative if
+// the segment has no length.
+template<typename T, int N>
+int Track<T, N>::FindSegment(float time, bool looping, float& outT, TrackCursor& cursor) const {
+	int frame = FrameIndex(time, looping, cursor);
+	if (frame < 0) {
+		return -1;
+	}
+	float thisTime = mTimes[frame];
+	float frameDelta = mTimes[frame + 1] - thisTime;
+	outT = -1.0f;
+	if (frameDelta > 0.0f) {
+		outT = (AdjustTimeToFitTrack(time, looping) - thisTime) / frameDelta;
+	}
+	return frame;
+}
+
+template<typename T, int N>
+T Track<T, N>::Evaluate(int frame, float t) const {
+	if (mInterpolation == Interpolation::Constant) {
+		return EvaluateAs<Interpolation::Constant>(frame, t);
+	}
+	else if (mInterpolation == Interpolation::Linear) {
+		return EvaluateAs<Interpolation::Linear>(frame, t);
+	}
+	return EvaluateAs<Interpolation::Cubic>(frame, t);
+}
+
+template<typename T, int N>
+template<Interpolation I>
+T Track<T, N>::EvaluateAs(int frame, float t) const {
+	if (I == Interpolation::Constant) {
+		return Cast(&mValues[frame * N]);
+	}
+	if (t < 0.0f) {
+		return T(); // Same as sampling a zero length segment
+	}
+	if (I == Interpolation::Linear) {
+		T start = Cast(&mValues[frame * N]);
+		T end = Cast(&mValues[(frame + 1) * N]);
+		return TrackHelpers::Interpolate(start, end, t);
+	}
+	return EvaluateCubic(frame, t);
+}
+
+template float Track<float, 1>::EvaluateAs<Interpolation::Constant>(int, float) const;
+template float Track<float, 1>::EvaluateAs<Interpolation::Linear>(int, float) const;
+template float Track<float, 1>::EvaluateAs<Interpolation::Cubic>(int, float) const;
+template vec3 Track<vec3, 3>::EvaluateAs<Interpolation::Constant>(int, float) const;
+template vec3 Track<vec3, 3>::EvaluateAs<Interpolation::Linear>(int, float) const;
+template vec3 Track<vec3, 3>::EvaluateAs<Interpolation::Cubic>(int, float) const;
+template Quaternion Track<Quaternion, 4>::EvaluateAs<Interpolation::Constant>(int, float) const;
+template Quaternion Track<Quaternion, 4>::EvaluateAs<Interpolation::Linear>(int, float) const;
+template Quaternion Track<Quaternion, 4>::EvaluateAs<Interpolation::Cubic>(int, float) const;
+
+template<typename T, int N>
+const std::vector<float>& Track<T, N>::GetTimes() const {
+	return mTimes;
+}
+
+// Value between two keys as if the keys between them did not exist
+template<typename T, int N>
+T Track<T, N>::SampleSegment(unsigned int first, unsigned int last, float time) {
+	T start = Cast(&mValues[first * N]);
+	float frameDelta = mTimes[last] - mTimes[first];
+	if (mInterpolation == Interpolation::Constant || frameDelta <= 0.0f) {
+		return start;
+	}
+	T end = Cast(&mValues[last * N]);
+	float t = (time - mTimes[first]) / frameDelta;
+	if (mInterpolation == Interpolation::Linear) {
+		return TrackHelpers::Interpolate(start, end, t);
+	}
+
+	T slope1;
+	memcpy(&slope1, &mOutTangents[first * N], N * sizeof(float));
+	T slope2;
+	memcpy(&slope2, &mInTangents[last * N], N * sizeof(float));
+	return Hermite(t, start, slope1 * frameDelta, end, slope2 * frameDelta);
+}
+
+// Can every key between first and last be removed without the track
+// moving further than tolerance from where it is now
+template<typename T, int N>
+bool Track<T, N>::SegmentFits(unsigned int first, unsigned int last, float tolerance) {
+	for (unsigned int i = first + 1; i < last; ++i) {
+		T expected = Cast(&mValues[i * N]);
+		T actual = SampleSegment(first, last, mTimes[i]);
+		if (TrackHelpers::Distance(expected, actual) > tolerance) {
+			return false;
+		}
+	}
+	if (mInterpolation == Interpolation::Cubic) {
+		// Curves can bulge between keys, check the middle of each segment
+		for (unsigned int i = first; i < last; ++i) {
+			float time = (mTimes[i] + mTimes[i + 1]) * 0.5f;
+			T expected = SampleSegment(i, i + 1, time); // The original curve
+			T actual = SampleSegment(first, last, time);
+			if (TrackHelpers::Distance(expected, actual) > tolerance) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+template<typename T, int N>
+unsigned int Track<T, N>::ReduceKeys(float tolerance) {
+	unsigned int size = Size();
+	if (size <= 2 || tolerance <= 0.0f) {
+		return size;
+	}
+
+	// Each segment reaches as far as it can before removing the keys
+	// inside it would be noticeable. The span doubles while it fits and
+	// the end is then found by bisection, so a long channel costs
+	// n log n key checks rather than n squared. The first and last keys
+	// are always kept.
+	std::vector<unsigned int> keep;
+	keep.push_back(0);
+	unsigned int first = 0;
+	while (first < size - 1) {
+		unsigned int fits = first + 1; // Neighbouring keys always fit
+		unsigned int span = 2;
+		while (first + span < size && SegmentFits(first, first + span, tolerance)) {
+			fits = first + span;
+			span *= 2;
+		}
+		unsigned int fails = first + span < size ? first + span : size;
+		while (fails - fits > 1) {
+			unsigned int middle = fits + (fails - fits) / 2;
+			if (SegmentFits(first, middle, tolerance)) {
+				fits = middle;
+			}
+			else {
+				fails = middle;
+			}
+		}
+		first = fits;
+		keep.push_back(first);
+	}
+	if (keep.size() == size) {
+		return size;
+	}
+
+	unsigned int numKeys = (unsigned int)keep.size();
+	bool isCubic = mInterpolation == Interpolation::Cubic;
+	for (unsigned int i = 0; i < numKeys; ++i) {
+		unsigned int k = keep[i]; // k >= i, so this never overwrites a kept key
+		mTimes[i] = mTimes[k];
+		memcpy(&mValues[i * N], &mValues[k * N], N * sizeof(float));
+		if (isCubic) {
+			memcpy(&mInTangents[i * N], &mInTangents[k * N], N * sizeof(float));
+			memcpy(&mOutTangents[i * N], &mOutTangents[k * N], N * sizeof(float));
+		}
+	}
+	float samplesPerSecond = mSamplesPerSecond;
+	bool hasCoefficients = mCoefficients.size() > 0;
+	Resize(numKeys);
+	mTimes.shrink_to_fit();
+	mValues.shrink_to_fit();
+	mInTangents.shrink_to_fit();
+	mOutTangents.shrink_to_fit();
+	if (samplesPerSecond > 0.0f) { // Resize dropped the lookup table
+		UpdateIndexLookupTable(samplesPerSecond);
+	}
+	if (hasCoefficients) { // And the coefficients
+		UpdateCubicCoefficients();
+	}
+	mCursor.Reset();
+	return numKeys;
+}
+
+// True if the track holds the same value the whole way through
+template<typename T, int N>
+bool Track<T, N>::IsConstant(float epsilon) {
+	unsigned int size = Size();
+	if (size == 0) {
+		return false;
+	}
+	T first = Cast(&mValues[0]);
+	for (unsigned int i = 1; i < size; ++i) {
+		if (TrackHelpers::Distance(first, Cast(&mValues[i * N])) > epsilon) {
+			return false;
+		}
+	}
+	// Equal keys can still curve between each other
+	for (unsigned int i = 0; i < mInTangents.size(); ++i) {
+		if (fabsf(mInTangents[i]) > epsilon || fabsf(mOutTangents[i]) > epsilon) {
+			return false;
+		}
+	}
+	return true;
+}
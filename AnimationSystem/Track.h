@@ -7,35 +7,107 @@
 #include "Quaternion.h"
 #include "Interpolation.h"
 
+// How many keys a cursor will step over before giving up and searching
+#define TRACK_CURSOR_MAX_STEPS 8
+// Default resolution of the time -> key lookup table
+#define TRACK_LOOKUP_SAMPLES_PER_SECOND 60.0f
+// Most samples SampleBatch interpolates between one pair of keys at once
+#define TRACK_BATCH_RUN 64
+
+// Define TRACK_BATCH_NO_SIMD to always use the scalar loops in SampleBatch
+#if !defined(TRACK_BATCH_NO_SIMD) && (defined(_M_X64) || \
+	(defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define TRACK_BATCH_SSE
+#endif
+
+// Remembers the key a track was last sampled at, so sequential playback
+// only has to step over the keys it passes instead of searching every time
+struct TrackCursor {
+	int mFrame;
+
+	inline TrackCursor() : mFrame(-1) { }
+	inline void Reset() { mFrame = -1; }
+};
+
+// Keys are stored as separate arrays rather than as Frame<N> records so the
+// time search only touches times, tangents only exist for cubic tracks
 template<typename T, int N>
 class Track {
 protected:
-	std::vector<Frame<N>> mFrames;
+	std::vector<float> mTimes;
+	std::vector<float> mValues; // N floats per key
+	std::vector<float> mInTangents; // N floats per key, cubic only
+	std::vector<float> mOutTangents; // N floats per key, cubic only
 	Interpolation mInterpolation;
+	TrackCursor mCursor; // Used when no cursor is given to Sample
+	std::vector<unsigned int> mSampledFrames; // Time bucket -> key index
+	float mSamplesPerSecond;
+	// Optional, cubic only. Hermite segments as a*t^3 + b*t^2 + c*t + d,
+	// 4 * N floats per segment, plus 1 / segment duration
+	std::vector<float> mCoefficients;
+	std::vector<float> mInvFrameDeltas;
 
 protected:
-	T SampleConstant(float time, bool looping);
-	T SampleLinear(float time, bool looping);
-	T SampleCubic(float time, bool looping);
-	T Hermite(float time, const T& p1, const T& s1, const T& p2, const T& s2);
+	T SampleConstant(float time, bool looping, TrackCursor& cursor) const;
+	T SampleLinear(float time, bool looping, TrackCursor& cursor) const;
+	T SampleCubic(float time, bool looping, TrackCursor& cursor) const;
+	T Hermite(float time, const T& p1, const T& s1, const T& p2, const T& s2) const;
+	T EvaluateCubic(int frame, float t) const;
+
+	T SampleSegment(unsigned int first, unsigned int last, float time);
+	bool SegmentFits(unsigned int first, unsigned int last, float tolerance);
 
-	int FrameIndex(float time, bool looping);
-	float AdjustTimeToFitTrack(float t, bool loop);
+	int FrameIndex(float time, bool looping, TrackCursor& cursor) const;
+	int FindFrame(float time) const;
+	int LookupFrame(float time) const;
+	float AdjustTimeToFitTrack(float t, bool loop) const;
 
-	T Cast(float* value); // Will be specialized
+	T Cast(const float* value) const; // Will be specialized
 
 public:
 	Track();
 	void Resize(unsigned int size);
-	unsigned int Size();
-	Interpolation GetInterpolation();
+	unsigned int Size() const;
+	Interpolation GetInterpolation() const;
 	void SetInterpolation(Interpolation interp);
 	float GetStartTime();
 	float GetEndTime();
 
-	T Sample(float time, bool looping);
-	Frame<N>& operator[](unsigned int index);
+	void UpdateIndexLookupTable(float samplesPerSecond);
+	void ClearIndexLookupTable();
+	unsigned int GetIndexLookupTableSize(); // In bytes
+	void UpdateCubicCoefficients();
+	void ClearCubicCoefficients();
+	unsigned int GetCubicCoefficientsSize(); // In bytes
+	unsigned int GetKeyMemorySize(); // In bytes
+	unsigned int ReduceKeys(float tolerance); // Returns the new key count
+	bool IsConstant(float epsilon);
 
+	T Sample(float time, bool looping); // Uses the track's own cursor
+	// Const sampling only reads the track, so any number of threads can
+	// sample one track at once as long as each passes its own cursor
+	T Sample(float time, bool looping, TrackCursor& cursor) const;
+	// Skips the branch on mInterpolation, I must match GetInterpolation()
+	template<Interpolation I>
+	T SampleAs(float time, bool looping);
+	template<Interpolation I>
+	T SampleAs(float time, bool looping, TrackCursor& cursor) const;
+	// Samples count sorted times into outValues, same results as Sample.
+	// Keys are found by walking forward, times are wrapped into the track
+	// once per segment rather than per sample, and the samples between
+	// one pair of linear keys are interpolated four at a time with SSE.
+	// Cubic samples are evaluated one at a time.
+	void SampleBatch(const float* times, unsigned int count, T* outValues, bool looping) const;
+	// Lets tracks with the same key times search for the segment once,
+	// frame and t come from FindSegment on any of those tracks
+	int FindSegment(float time, bool looping, float& outT, TrackCursor& cursor) const;
+	T Evaluate(int frame, float t) const;
+	template<Interpolation I>
+	T EvaluateAs(int frame, float t) const;
+	const std::vector<float>& GetTimes() const;
+	Frame<N> GetFrame(unsigned int index);
+	T GetValue(unsigned int index) const;
+	void SetFrame(unsigned int index, const Frame<N>& frame);
 };
 
 typedef Track<float, 1> ScalarTrack;
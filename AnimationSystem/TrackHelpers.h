@@ -0,0 +1,61 @@
+#ifndef _H_TRACKHELPERS_
+#define _H_TRACKHELPERS_
+
+#include <cmath>
+#include "vec3.h"
+#include "Quaternion.h"
+
+namespace TrackHelpers {
+	// linearly interpolate functions
+	inline float Interpolate(float a, float b, float t) {
+		return a + (b - a) * t;
+	}
+
+	inline vec3 Interpolate(const vec3& a, const vec3& b, float t) {
+		return Lerp(a, b, t);
+	}
+	inline Quaternion Interpolate(const Quaternion& a, const Quaternion& b,
+		float t) {
+		Quaternion result = Mix(a, b, t);
+		if (Dot(a, b) < 0) { // Neighborhood
+			result = Mix(a, -b, t);
+		}
+		return Normalised(result); //NLerp, not slerp
+	}
+
+	inline float AdjustHermiteResult(float f) {
+		return f;
+	}
+	inline vec3 AdjustHermiteResult(const vec3& v) {
+		return v;
+	}
+	inline Quaternion AdjustHermiteResult(const Quaternion& q) {
+		return Normalised(q);
+	}
+	inline void Neighborhood(const float& a, float& b) {}
+	inline void Neighborhood(const vec3& a, vec3& b) {}
+	inline void Neighborhood(const Quaternion& a, Quaternion& b) {
+		if (Dot(a, b) < 0) {
+			b = -b;
+		}
+	}
+
+	// How far apart two samples are, used to measure resampling error
+	inline float Distance(float a, float b) {
+		return fabsf(a - b);
+	}
+	inline float Distance(const vec3& a, const vec3& b) {
+		return sqrtf(LenSq(a - b)); // Len rounds small lengths to zero
+	}
+	inline float Distance(const Quaternion& a, const Quaternion& b) {
+		Quaternion c = b;
+		Neighborhood(a, c); // q and -q are the same rotation
+		float chord = sqrtf(LenSq(a - c)) * 0.5f;
+		if (chord > 1.0f) {
+			chord = 1.0f;
+		}
+		return 4.0f * asinf(chord); // Angle in radians, stable near zero
+	}
+}
+
+#endif // !_H_TRACKHELPERS_
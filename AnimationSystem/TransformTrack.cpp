@@ -1,10 +1,18 @@
 #include "TransformTrack.h"
+#include "TrackHelpers.h"
 
 TransformTrack::TransformTrack() {
 	mId = 0;
+	mHasConstantPosition = false;
+	mHasConstantRotation = false;
+	mHasConstantScale = false;
+	mHasCollapsedRange = false;
+	mCollapsedStartTime = 0.0f;
+	mCollapsedEndTime = 0.0f;
+	mSharedTimeline = false;
 }
 
-unsigned int TransformTrack::GetId() {
+unsigned int TransformTrack::GetId() const {
 	return mId;
 }
 
@@ -13,19 +21,232 @@ void TransformTrack::SetId(unsigned int id) {
 }
 
 VectorTrack& TransformTrack::GetPositionTrack() {
+	mSharedTimeline = false; // The keys may be edited
 	return mPosition;
 }
 
 QuaternionTrack& TransformTrack::GetRotationTrack() {
+	mSharedTimeline = false; // The keys may be edited
 	return mRotation;
 }
 
 VectorTrack& TransformTrack::GetScaleTrack() {
+	mSharedTimeline = false; // The keys may be edited
 	return mScale;
 }
 
 bool TransformTrack::IsValid() {
-	return mPosition.Size() > 1 || mRotation.Size() > 1 || mScale.Size() > 1;
+	return mPosition.Size() > 1 || mRotation.Size() > 1 || mScale.Size() > 1 ||
+		mQuantizedPosition.Size() > 1 || mQuantizedRotation.Size() > 1 ||
+		mQuantizedScale.Size() > 1 || mHasCollapsedRange;
+}
+
+void TransformTrack::KeepCollapsedRange(float startTime, float endTime) {
+	if (!mHasCollapsedRange || startTime < mCollapsedStartTime) {
+		mCollapsedStartTime = startTime;
+	}
+	if (!mHasCollapsedRange || endTime > mCollapsedEndTime) {
+		mCollapsedEndTime = endTime;
+	}
+	mHasCollapsedRange = true;
+}
+
+// Swaps channels whose keys are all the same for a single value, so
+// sampling them is a copy. Returns how many channels were collapsed.
+unsigned int TransformTrack::CollapseConstantChannels(float epsilon) {
+	unsigned int result = 0;
+	if (mPosition.Size() > 0 && mPosition.IsConstant(epsilon)) {
+		Frame<3> frame = mPosition.GetFrame(0);
+		mConstant.position = vec3(frame.mValue);
+		if (mPosition.Size() > 1) {
+			KeepCollapsedRange(mPosition.GetStartTime(), mPosition.GetEndTime());
+		}
+		mHasConstantPosition = true;
+		mPosition = VectorTrack();
+		++result;
+	}
+	if (mRotation.Size() > 0 && mRotation.IsConstant(epsilon)) {
+		Frame<4> frame = mRotation.GetFrame(0);
+		mConstant.rotation = Quaternion(frame.mValue[0], frame.mValue[1],
+			frame.mValue[2], frame.mValue[3]);
+		if (mRotation.Size() > 1) {
+			KeepCollapsedRange(mRotation.GetStartTime(), mRotation.GetEndTime());
+		}
+		mHasConstantRotation = true;
+		mRotation = QuaternionTrack();
+		++result;
+	}
+	if (mScale.Size() > 0 && mScale.IsConstant(epsilon)) {
+		Frame<3> frame = mScale.GetFrame(0);
+		mConstant.scale = vec3(frame.mValue);
+		if (mScale.Size() > 1) {
+			KeepCollapsedRange(mScale.GetStartTime(), mScale.GetEndTime());
+		}
+		mHasConstantScale = true;
+		mScale = VectorTrack();
+		++result;
+	}
+	return result;
+}
+
+// Drops constant channels that hold the same value as ref (usually the
+// rest pose), the clip must then be sampled on top of ref. Returns how
+// many channels were removed.
+unsigned int TransformTrack::RemoveConstantChannels(const Transform& ref, float epsilon) {
+	unsigned int result = 0;
+	if (mHasConstantPosition && TrackHelpers::Distance(mConstant.position, ref.position) <= epsilon) {
+		mHasConstantPosition = false;
+		++result;
+	}
+	if (mHasConstantRotation && TrackHelpers::Distance(mConstant.rotation, ref.rotation) <= epsilon) {
+		mHasConstantRotation = false;
+		++result;
+	}
+	if (mHasConstantScale && TrackHelpers::Distance(mConstant.scale, ref.scale) <= epsilon) {
+		mHasConstantScale = false;
+		++result;
+	}
+	return result;
+}
+
+// Checks if the animated channels all have the same key times. If they
+// do, sampling searches for the key once and only the first channel keeps
+// its lookup table. Call again after editing the channels.
+bool TransformTrack::UpdateSharedTimeline() {
+	mSharedTimeline = false;
+	if (IsQuantized()) {
+		return false;
+	}
+	const std::vector<float>* times = 0;
+	unsigned int numChannels = 0;
+	if (mPosition.Size() > 1) {
+		times = &mPosition.GetTimes();
+		++numChannels;
+	}
+	if (mRotation.Size() > 1) {
+		if (times != 0 && mRotation.GetTimes() != *times) {
+			return false;
+		}
+		times = &mRotation.GetTimes();
+		++numChannels;
+	}
+	if (mScale.Size() > 1) {
+		if (times != 0 && mScale.GetTimes() != *times) {
+			return false;
+		}
+		++numChannels;
+	}
+	if (numChannels < 2) {
+		return false; // Nothing to share
+	}
+
+	mSharedTimeline = true;
+	if (mPosition.Size() > 1) {
+		mRotation.ClearIndexLookupTable();
+		mScale.ClearIndexLookupTable();
+	}
+	else {
+		mScale.ClearIndexLookupTable();
+	}
+	return true;
+}
+
+bool TransformTrack::HasSharedTimeline() {
+	return mSharedTimeline;
+}
+
+// Segment and blend factor for all channels, -1 if they do not share keys
+int TransformTrack::FindSharedSegment(float time, bool looping, float& outT, TransformTrackCursor& cursor) const {
+	if (!mSharedTimeline) {
+		return -1;
+	}
+	if (mPosition.Size() > 1) {
+		return mPosition.FindSegment(time, looping, outT, cursor.mPosition);
+	}
+	return mRotation.FindSegment(time, looping, outT, cursor.mRotation);
+}
+
+bool TransformTrack::IsQuantized() {
+	return mQuantizedPosition.Size() > 0 || mQuantizedRotation.Size() > 0 ||
+		mQuantizedScale.Size() > 0;
+}
+
+// Returns false if the animated channels use different interpolations
+bool TransformTrack::GetInterpolation(Interpolation& outInterpolation) {
+	if (IsQuantized()) {
+		return false; // SampleAs only samples float channels
+	}
+	bool isSet = false;
+	if (mPosition.Size() > 1) {
+		outInterpolation = mPosition.GetInterpolation();
+		isSet = true;
+	}
+	if (mRotation.Size() > 1) {
+		if (isSet && mRotation.GetInterpolation() != outInterpolation) {
+			return false;
+		}
+		outInterpolation = mRotation.GetInterpolation();
+		isSet = true;
+	}
+	if (mScale.Size() > 1) {
+		if (isSet && mScale.GetInterpolation() != outInterpolation) {
+			return false;
+		}
+		outInterpolation = mScale.GetInterpolation();
+	}
+	return true;
+}
+
+unsigned int TransformTrack::GetIndexLookupTableSize() {
+	return mPosition.GetIndexLookupTableSize() +
+		mRotation.GetIndexLookupTableSize() +
+		mScale.GetIndexLookupTableSize();
+}
+
+void TransformTrack::ClearIndexLookupTables() {
+	mPosition.ClearIndexLookupTable();
+	mRotation.ClearIndexLookupTable();
+	mScale.ClearIndexLookupTable();
+}
+
+void TransformTrack::UpdateCubicCoefficients() {
+	mPosition.UpdateCubicCoefficients(); // Does nothing unless cubic
+	mRotation.UpdateCubicCoefficients();
+	mScale.UpdateCubicCoefficients();
+}
+
+void TransformTrack::ClearCubicCoefficients() {
+	mPosition.ClearCubicCoefficients();
+	mRotation.ClearCubicCoefficients();
+	mScale.ClearCubicCoefficients();
+}
+
+unsigned int TransformTrack::GetCubicCoefficientsSize() {
+	return mPosition.GetCubicCoefficientsSize() +
+		mRotation.GetCubicCoefficientsSize() +
+		mScale.GetCubicCoefficientsSize();
+}
+
+unsigned int TransformTrack::GetKeyMemorySize() {
+	return mPosition.GetKeyMemorySize() + mRotation.GetKeyMemorySize() +
+		mScale.GetKeyMemorySize() + mQuantizedPosition.GetKeyMemorySize() +
+		mQuantizedRotation.GetKeyMemorySize() + mQuantizedScale.GetKeyMemorySize();
+}
+
+void TransformTrack::Quantize() {
+	mSharedTimeline = false;
+	if (mPosition.Size() > 0) {
+		mQuantizedPosition.Quantize(mPosition);
+		mPosition = VectorTrack(); // Release the float keys
+	}
+	if (mRotation.Size() > 0) {
+		mQuantizedRotation.Quantize(mRotation);
+		mRotation = QuaternionTrack();
+	}
+	if (mScale.Size() > 0) {
+		mQuantizedScale.Quantize(mScale);
+		mScale = VectorTrack();
+	}
 }
 
 float TransformTrack::GetStartTime() {
@@ -50,6 +271,30 @@ float TransformTrack::GetStartTime() {
 			isSet = true;
 		}
 	}
+	if (mQuantizedPosition.Size() > 1) {
+		float positionStart = mQuantizedPosition.GetStartTime();
+		if (positionStart < result || !isSet) {
+			result = positionStart;
+			isSet = true;
+		}
+	}
+	if (mQuantizedRotation.Size() > 1) {
+		float rotationStart = mQuantizedRotation.GetStartTime();
+		if (rotationStart < result || !isSet) {
+			result = rotationStart;
+			isSet = true;
+		}
+	}
+	if (mQuantizedScale.Size() > 1) {
+		float scaleStart = mQuantizedScale.GetStartTime();
+		if (scaleStart < result || !isSet) {
+			result = scaleStart;
+			isSet = true;
+		}
+	}
+	if (mHasCollapsedRange && (mCollapsedStartTime < result || !isSet)) {
+		result = mCollapsedStartTime;
+	}
 
 	return result;
 }
@@ -76,20 +321,206 @@ float TransformTrack::GetEndTime() {
 			isSet = true;
 		}
 	}
+	if (mQuantizedPosition.Size() > 1) {
+		float positionEnd = mQuantizedPosition.GetEndTime();
+		if (positionEnd > result || !isSet) {
+			result = positionEnd;
+			isSet = true;
+		}
+	}
+	if (mQuantizedRotation.Size() > 1) {
+		float rotationEnd = mQuantizedRotation.GetEndTime();
+		if (rotationEnd > result || !isSet) {
+			result = rotationEnd;
+			isSet = true;
+		}
+	}
+	if (mQuantizedScale.Size() > 1) {
+		float scaleEnd = mQuantizedScale.GetEndTime();
+		if (scaleEnd > result || !isSet) {
+			result = scaleEnd;
+			isSet = true;
+		}
+	}
+	if (mHasCollapsedRange && (mCollapsedEndTime > result || !isSet)) {
+		result = mCollapsedEndTime;
+	}
 
 	return result;
 }
 
 Transform TransformTrack::Sample(const Transform& ref, float time, bool looping) {
 	Transform result = ref; // Assign default values
+	SampleInPlace(result, time, looping, mCursor);
+	return result;
+}
+
+Transform TransformTrack::Sample(const Transform& ref, float time, bool looping, TransformTrackCursor& cursor) const {
+	Transform result = ref;
+	SampleInPlace(result, time, looping, cursor);
+	return result;
+}
+
+// Writes only the animated channels of inOutTransform, so a pose can be
+// sampled without copying transforms in and out of it
+void TransformTrack::SampleInPlace(Transform& inOutTransform, float time, bool looping, TransformTrackCursor& cursor) const {
+	float t = 0.0f;
+	int frame = FindSharedSegment(time, looping, t, cursor);
+	SamplePosition(inOutTransform, time, looping, frame, t, cursor);
+	SampleRotation(inOutTransform, time, looping, frame, t, cursor);
+	SampleScale(inOutTransform, time, looping, frame, t, cursor);
+}
+
+// Like SampleInPlace, but a linear rotation channel is not interpolated.
+// Returns true if the rotation was left out, its keys are in outRotation
+// and the nlerp is up to the caller so it can be done for many joints.
+bool TransformTrack::SampleDeferred(Transform& outTransform, float time, bool looping,
+	RotationSegment& outRotation, TransformTrackCursor& cursor) const {
+	float t = 0.0f;
+	int frame = FindSharedSegment(time, looping, t, cursor);
+	SamplePosition(outTransform, time, looping, frame, t, cursor);
+	SampleScale(outTransform, time, looping, frame, t, cursor);
+
+	if (mRotation.Size() > 1 && mRotation.GetInterpolation() == Interpolation::Linear) {
+		float rotationT = t;
+		int rotationFrame = frame >= 0 ? frame :
+			mRotation.FindSegment(time, looping, rotationT, cursor.mRotation);
+		if (rotationFrame >= 0 && rotationT >= 0.0f) {
+			outRotation.mStart = mRotation.GetValue(rotationFrame);
+			outRotation.mEnd = mRotation.GetValue(rotationFrame + 1);
+			outRotation.mT = rotationT;
+			return true;
+		}
+	}
+	SampleRotation(outTransform, time, looping, frame, t, cursor);
+	return false;
+}
+
+// frame and t come from FindSharedSegment, frame is -1 if not shared
+void TransformTrack::SamplePosition(Transform& result, float time, bool looping, int frame, float t, TransformTrackCursor& cursor) const {
 	if (mPosition.Size() > 1) { // Only assign if animated
-		result.position = mPosition.Sample(time, looping);
+		result.position = frame >= 0 ? mPosition.Evaluate(frame, t) :
+			mPosition.Sample(time, looping, cursor.mPosition);
+	}
+	else if (mQuantizedPosition.Size() > 1) {
+		result.position = mQuantizedPosition.Sample(time, looping, cursor.mPosition);
+	}
+	else if (mHasConstantPosition) {
+		result.position = mConstant.position;
 	}
+}
+
+void TransformTrack::SampleRotation(Transform& result, float time, bool looping, int frame, float t, TransformTrackCursor& cursor) const {
 	if (mRotation.Size() > 1) { // Only assign if animated
-		result.rotation = mRotation.Sample(time, looping);
+		result.rotation = frame >= 0 ? mRotation.Evaluate(frame, t) :
+			mRotation.Sample(time, looping, cursor.mRotation);
+	}
+	else if (mQuantizedRotation.Size() > 1) {
+		result.rotation = mQuantizedRotation.Sample(time, looping, cursor.mRotation);
 	}
+	else if (mHasConstantRotation) {
+		result.rotation = mConstant.rotation;
+	}
+}
+
+void TransformTrack::SampleScale(Transform& result, float time, bool looping, int frame, float t, TransformTrackCursor& cursor) const {
 	if (mScale.Size() > 1) { // Only assign if animated
-		result.scale = mScale.Sample(time, looping);
+		result.scale = frame >= 0 ? mScale.Evaluate(frame, t) :
+			mScale.Sample(time, looping, cursor.mScale);
+	}
+	else if (mQuantizedScale.Size() > 1) {
+		result.scale = mQuantizedScale.Sample(time, looping, cursor.mScale);
+	}
+	else if (mHasConstantScale) {
+		result.scale = mConstant.scale;
 	}
+}
+
+template<Interpolation I>
+Transform TransformTrack::SampleAs(const Transform& ref, float time, bool looping) {
+	Transform result = ref;
+	SampleInPlaceAs<I>(result, time, looping, mCursor);
 	return result;
-}
\ No newline at end of file
+}
+
+template<Interpolation I>
+void TransformTrack::SampleInPlaceAs(Transform& inOutTransform, float time, bool looping, TransformTrackCursor& cursor) const {
+	float t = 0.0f;
+	int frame = FindSharedSegment(time, looping, t, cursor);
+	if (mPosition.Size() > 1) {
+		inOutTransform.position = frame >= 0 ? mPosition.EvaluateAs<I>(frame, t) :
+			mPosition.SampleAs<I>(time, looping, cursor.mPosition);
+	}
+	else if (mHasConstantPosition) {
+		inOutTransform.position = mConstant.position;
+	}
+	if (mRotation.Size() > 1) {
+		inOutTransform.rotation = frame >= 0 ? mRotation.EvaluateAs<I>(frame, t) :
+			mRotation.SampleAs<I>(time, looping, cursor.mRotation);
+	}
+	else if (mHasConstantRotation) {
+		inOutTransform.rotation = mConstant.rotation;
+	}
+	if (mScale.Size() > 1) {
+		inOutTransform.scale = frame >= 0 ? mScale.EvaluateAs<I>(frame, t) :
+			mScale.SampleAs<I>(time, looping, cursor.mScale);
+	}
+	else if (mHasConstantScale) {
+		inOutTransform.scale = mConstant.scale;
+	}
+}
+
+template Transform TransformTrack::SampleAs<Interpolation::Constant>(const Transform&, float, bool);
+template Transform TransformTrack::SampleAs<Interpolation::Linear>(const Transform&, float, bool);
+template Transform TransformTrack::SampleAs<Interpolation::Cubic>(const Transform&, float, bool);
+template void TransformTrack::SampleInPlaceAs<Interpolation::Constant>(Transform&, float, bool, TransformTrackCursor&) const;
+template void TransformTrack::SampleInPlaceAs<Interpolation::Linear>(Transform&, float, bool, TransformTrackCursor&) const;
+template void TransformTrack::SampleInPlaceAs<Interpolation::Cubic>(Transform&, float, bool, TransformTrackCursor&) const;
+
+void TransformTrack::SampleBatch(const float* times, unsigned int count, Transform* inOutTransforms, bool looping) const {
+	if (mPosition.Size() > 1 || mScale.Size() > 1) {
+		std::vector<vec3> values(count);
+		if (mPosition.Size() > 1) {
+			mPosition.SampleBatch(times, count, &values[0], looping);
+			for (unsigned int i = 0; i < count; ++i) {
+				inOutTransforms[i].position = values[i];
+			}
+		}
+		if (mScale.Size() > 1) {
+			mScale.SampleBatch(times, count, &values[0], looping);
+			for (unsigned int i = 0; i < count; ++i) {
+				inOutTransforms[i].scale = values[i];
+			}
+		}
+	}
+	if (mRotation.Size() > 1) {
+		std::vector<Quaternion> values(count);
+		mRotation.SampleBatch(times, count, &values[0], looping);
+		for (unsigned int i = 0; i < count; ++i) {
+			inOutTransforms[i].rotation = values[i];
+		}
+	}
+
+	TransformTrackCursor cursors;
+	for (unsigned int i = 0; i < count; ++i) {
+		Transform& result = inOutTransforms[i];
+		if (mQuantizedPosition.Size() > 1) {
+			result.position = mQuantizedPosition.Sample(times[i], looping, cursors.mPosition);
+		}
+		else if (mHasConstantPosition) {
+			result.position = mConstant.position;
+		}
+		if (mQuantizedRotation.Size() > 1) {
+			result.rotation = mQuantizedRotation.Sample(times[i], looping, cursors.mRotation);
+		}
+		else if (mHasConstantRotation) {
+			result.rotation = mConstant.rotation;
+		}
+		if (mQuantizedScale.Size() > 1) {
+			result.scale = mQuantizedScale.Sample(times[i], looping, cursors.mScale);
+		}
+		else if (mHasConstantScale) {
+			result.scale = mConstant.scale;
+		}
+	}
+}
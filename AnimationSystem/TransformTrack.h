@@ -2,7 +2,16 @@
 #define _H_TRANSFORMTRACK_
 
 #include "Track.h"
+#include "QuantizedTrack.h"
 #include "Transform.h"
+#include "RotationBatch.h"
+
+// Where each channel of a transform track was last sampled, see TrackCursor
+struct TransformTrackCursor {
+	TrackCursor mPosition;
+	TrackCursor mRotation;
+	TrackCursor mScale;
+};
 
 class TransformTrack {
 protected:
@@ -10,10 +19,33 @@ protected:
 	VectorTrack mPosition;
 	QuaternionTrack mRotation;
 	VectorTrack mScale;
+	// Replace the float channels above once Quantize has been called
+	QuantizedVectorTrack mQuantizedPosition;
+	QuantizedQuaternionTrack mQuantizedRotation;
+	QuantizedVectorTrack mQuantizedScale;
+	// Channels that never change are stored as a single value
+	Transform mConstant;
+	bool mHasConstantPosition;
+	bool mHasConstantRotation;
+	bool mHasConstantScale;
+	// Key time range of the collapsed channels, so the track keeps its
+	// duration when every channel has been collapsed
+	bool mHasCollapsedRange;
+	float mCollapsedStartTime;
+	float mCollapsedEndTime;
+	bool mSharedTimeline; // Animated channels have the same key times
+	TransformTrackCursor mCursor; // Used by the non const Sample functions
+
+protected:
+	void KeepCollapsedRange(float startTime, float endTime);
+	int FindSharedSegment(float time, bool looping, float& outT, TransformTrackCursor& cursor) const;
+	void SamplePosition(Transform& result, float time, bool looping, int frame, float t, TransformTrackCursor& cursor) const;
+	void SampleRotation(Transform& result, float time, bool looping, int frame, float t, TransformTrackCursor& cursor) const;
+	void SampleScale(Transform& result, float time, bool looping, int frame, float t, TransformTrackCursor& cursor) const;
 
 public:
 	TransformTrack();
-	unsigned int GetId();
+	unsigned int GetId() const;
 	void SetId(unsigned int id);
 	VectorTrack& GetPositionTrack();
 	QuaternionTrack& GetRotationTrack();
@@ -21,8 +53,43 @@ public:
 	float GetStartTime();
 	float GetEndTime();
 	bool IsValid();
+	bool GetInterpolation(Interpolation& outInterpolation);
+	unsigned int GetIndexLookupTableSize();
+	void ClearIndexLookupTables();
+	void UpdateCubicCoefficients();
+	void ClearCubicCoefficients();
+	unsigned int GetCubicCoefficientsSize();
+	unsigned int GetKeyMemorySize();
+	void Quantize();
+	bool IsQuantized();
+	unsigned int CollapseConstantChannels(float epsilon);
+	unsigned int RemoveConstantChannels(const Transform& ref, float epsilon);
+	bool UpdateSharedTimeline();
+	bool HasSharedTimeline();
 	Transform Sample(const Transform& ref, float time,
 		bool looping);
+	// The const functions only read the track, any number of threads can
+	// sample it at once as long as each one passes its own cursor
+	Transform Sample(const Transform& ref, float time, bool looping,
+		TransformTrackCursor& cursor) const;
+	void SampleInPlace(Transform& inOutTransform, float time, bool looping,
+		TransformTrackCursor& cursor) const;
+	// Like SampleInPlace but a linear rotation is not interpolated, its
+	// bracketing keys go to outRotation for NlerpBatch. Returns false if
+	// the rotation was sampled here instead.
+	bool SampleDeferred(Transform& inOutTransform, float time, bool looping,
+		RotationSegment& outRotation, TransformTrackCursor& cursor) const;
+	// Every animated channel must use interpolation I
+	template<Interpolation I>
+	Transform SampleAs(const Transform& ref, float time,
+		bool looping);
+	template<Interpolation I>
+	void SampleInPlaceAs(Transform& inOutTransform, float time, bool looping,
+		TransformTrackCursor& cursor) const;
+	// inOutTransforms holds the reference transform for each time on input,
+	// channels this track does not animate are left as they are
+	void SampleBatch(const float* times, unsigned int count,
+		Transform* inOutTransforms, bool looping) const;
 };
 
 #endif // ! _H_TRANSFORMTRACK_
@@ -0,0 +1,71 @@
+#include "Tests.h"
+#include "TestRig.h"
+
+// Frames sampled by each clip benchmark
+#define CLIP_BENCHMARK_FRAMES 20000
+
+void BenchmarkSamplingBackends() {
+	Clip clip = MakeTestClip(TEST_RIG_JOINTS, Interpolation::Linear);
+	Pose rest = MakeTestRig(TEST_RIG_JOINTS, true);
+	SamplingBackend backends[2] = { SamplingBackend::Scalar, SamplingBackend::Simd };
+	const char* names[2] = { "Scalar", "Simd" };
+	Pose results[2];
+
+	std::printf("Clip::Sample, %d joints, linear keys\n", TEST_RIG_JOINTS);
+	for (int b = 0; b < 2; ++b) {
+		clip.SetSamplingBackend(backends[b]);
+		Pose pose = rest;
+		ClipCursor cursor;
+		double time = MeasureMicroseconds(CLIP_BENCHMARK_FRAMES, [&](unsigned int frame) {
+			clip.Sample(pose, (float)frame / 60.0f, cursor);
+		});
+		std::printf("  %-8s %8.3f us per pose\n", names[b], time);
+		results[b] = pose;
+	}
+	TEST_CHECK(PoseDifference(results[0], results[1]) < 1e-6f);
+}
+
+void BenchmarkInPlaceSampling() {
+	Clip clip = MakeTestClip(TEST_RIG_JOINTS, Interpolation::Linear);
+	Pose rest = MakeTestRig(TEST_RIG_JOINTS, true);
+	std::vector<TransformTrack*> tracks(TEST_RIG_JOINTS);
+	for (unsigned int j = 0; j < TEST_RIG_JOINTS; ++j) {
+		tracks[j] = &clip[j];
+	}
+	clip.RecalculateInterpolation(); // operator[] clears it
+	clip.SetSamplingBackend(SamplingBackend::Scalar);
+	std::vector<TransformTrackCursor> cursors(TEST_RIG_JOINTS);
+
+	std::printf("Clip sampling, %d joints, copy out and back vs in place\n", TEST_RIG_JOINTS);
+	// How every track was sampled before SampleInPlace
+	Pose copied = rest;
+	double time = MeasureMicroseconds(CLIP_BENCHMARK_FRAMES, [&](unsigned int frame) {
+		float t = (float)frame / 60.0f;
+		for (unsigned int j = 0; j < TEST_RIG_JOINTS; ++j) {
+			Transform local = copied.GetLocalTransform(j);
+			copied.SetLocalTransform(j, tracks[j]->Sample(local, t, true, cursors[j]));
+		}
+	});
+	std::printf("  %-22s %8.3f us per pose\n", "Sample, copied", time);
+
+	Pose inPlace = rest;
+	time = MeasureMicroseconds(CLIP_BENCHMARK_FRAMES, [&](unsigned int frame) {
+		float t = (float)frame / 60.0f;
+		Transform* locals = inPlace.GetLocalTransformData();
+		for (unsigned int j = 0; j < TEST_RIG_JOINTS; ++j) {
+			tracks[j]->SampleInPlace(locals[j], t, true, cursors[j]);
+			inPlace.MarkDirty(j);
+		}
+	});
+	std::printf("  %-22s %8.3f us per pose\n", "SampleInPlace", time);
+
+	Pose sampled = rest;
+	ClipCursor cursor;
+	time = MeasureMicroseconds(CLIP_BENCHMARK_FRAMES, [&](unsigned int frame) {
+		clip.Sample(sampled, (float)frame / 60.0f, cursor);
+	});
+	std::printf("  %-22s %8.3f us per pose\n", "Clip::Sample", time);
+
+	TEST_CHECK(PoseDifference(copied, inPlace) < 1e-6f);
+	TEST_CHECK(PoseDifference(copied, sampled) < 1e-6f);
+}
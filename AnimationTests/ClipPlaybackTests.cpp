@@ -0,0 +1,59 @@
+#include "Tests.h"
+#include "TestRig.h"
+
+namespace ClipPlaybackHelpers {
+	// One joint moving along x, keyed from 1 to 3 seconds
+	Clip MakeOffsetClip(bool looping) {
+		Clip result;
+		VectorTrack& track = result[0].GetPositionTrack();
+		track.Resize(3);
+		for (unsigned int i = 0; i < 3; ++i) {
+			VectorFrame frame;
+			frame.mTime = 1.0f + (float)i;
+			for (int c = 0; c < 3; ++c) {
+				frame.mValue[c] = c == 0 ? (float)i : 0.0f;
+				frame.mIn[c] = 0.0f;
+				frame.mOut[c] = 0.0f;
+			}
+			track.SetFrame(i, frame);
+		}
+		result.RecalculateDuration();
+		result.RecalculateInterpolation();
+		result.SetLooping(looping);
+		return result;
+	}
+}
+
+void TestOffsetStartPlayback() {
+	Clip clip = ClipPlaybackHelpers::MakeOffsetClip(true);
+	Pose pose(1);
+	ClipCursor cursor;
+	PlaybackTime time;
+
+	// A default PlaybackTime starts on the first key without wrapping
+	TEST_CHECK(clip.Sample(pose, time, 0.0f, cursor) == 0);
+	TEST_CHECK(time.mLoops == 0);
+	TEST_CHECK(pose.GetLocalTransform(0).position.x == 0.0f);
+
+	TEST_CHECK(clip.Sample(pose, time, 0.5f, cursor) == 0);
+	TEST_CHECK(fabsf(pose.GetLocalTransform(0).position.x - 0.5f) < 1e-6f);
+	int wraps = 0;
+	for (int i = 0; i < 3; ++i) {
+		wraps += clip.Sample(pose, time, 0.5f, cursor);
+	}
+	TEST_CHECK(wraps == 1); // Exactly one lap, back on the first key
+	TEST_CHECK(time.mLoops == 1);
+	TEST_CHECK(pose.GetLocalTransform(0).position.x == 0.0f);
+
+	// Stepping back past the start wraps backwards once
+	TEST_CHECK(clip.Sample(pose, time, -0.5f, cursor) == -1);
+	TEST_CHECK(time.mLoops == 0);
+	TEST_CHECK(fabsf(pose.GetLocalTransform(0).position.x - 1.5f) < 1e-6f);
+
+	Clip once = ClipPlaybackHelpers::MakeOffsetClip(false);
+	PlaybackTime clamped;
+	TEST_CHECK(once.Sample(pose, clamped, -1.0f, cursor) == 0);
+	TEST_CHECK(pose.GetLocalTransform(0).position.x == 0.0f);
+	TEST_CHECK(once.Sample(pose, clamped, 5.0f, cursor) == 0);
+	TEST_CHECK(pose.GetLocalTransform(0).position.x == 2.0f);
+}
@@ -0,0 +1,90 @@
+#include "Tests.h"
+#include "TestRig.h"
+#include <thread>
+#include <vector>
+
+// Threads sampling one clip at the same time
+#define CLIP_THREAD_COUNT 8
+// Frames each thread samples, every thread starts at a different one
+#define CLIP_THREAD_FRAMES 240
+#define CLIP_THREAD_PASSES 4
+
+namespace ClipThreadHelpers {
+	// Locals of every frame, sampled on one thread
+	std::vector<Transform> SampleFrames(const Clip& clip, Pose& rest, bool rawPose) {
+		std::vector<Transform> result(CLIP_THREAD_FRAMES * rest.Size());
+		Pose pose = rest;
+		ClipCursor cursor;
+		for (unsigned int f = 0; f < CLIP_THREAD_FRAMES; ++f) {
+			float time = (float)f / 60.0f;
+			if (rawPose) {
+				clip.Sample(pose.GetLocalTransformData(), pose.Size(), time, cursor);
+			}
+			else {
+				clip.Sample(pose, time, cursor);
+			}
+			for (unsigned int j = 0; j < pose.Size(); ++j) {
+				result[f * pose.Size() + j] = pose.GetLocalTransform(j);
+			}
+		}
+		return result;
+	}
+
+	// Every thread has its own cursor and pose, the clip is shared
+	unsigned int SampleOnThreads(const Clip& clip, Pose& rest, bool rawPose, const std::vector<Transform>& expected) {
+		unsigned int mismatches[CLIP_THREAD_COUNT] = { 0 };
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < CLIP_THREAD_COUNT; ++i) {
+			threads.push_back(std::thread([&clip, &rest, &expected, &mismatches, rawPose, i]() {
+				Pose pose = rest;
+				ClipCursor cursor;
+				unsigned int size = pose.Size();
+				for (unsigned int n = 0; n < CLIP_THREAD_FRAMES * CLIP_THREAD_PASSES; ++n) {
+					unsigned int f = (n + i * 37) % CLIP_THREAD_FRAMES;
+					float time = (float)f / 60.0f;
+					if (rawPose) {
+						clip.Sample(pose.GetLocalTransformData(), size, time, cursor);
+					}
+					else {
+						clip.Sample(pose, time, cursor);
+					}
+					for (unsigned int j = 0; j < size; ++j) {
+						if (TransformDifference(pose.GetLocalTransform(j), expected[f * size + j]) != 0.0f) {
+							++mismatches[i];
+						}
+					}
+				}
+			}));
+		}
+		unsigned int result = 0;
+		for (unsigned int i = 0; i < CLIP_THREAD_COUNT; ++i) {
+			threads[i].join();
+			result += mismatches[i];
+		}
+		return result;
+	}
+}
+
+void TestConcurrentSampling() {
+	Pose rest = MakeTestRig(TEST_RIG_JOINTS, true);
+
+	Clip scalar = MakeTestClip(TEST_RIG_JOINTS, Interpolation::Linear);
+	scalar.SetSamplingBackend(SamplingBackend::Scalar);
+	Clip simd = scalar;
+	simd.SetSamplingBackend(SamplingBackend::Simd);
+	// Mixed interpolation, every track is sampled with SampleInPlace
+	Clip inPlace = scalar;
+	for (unsigned int j = 0; j < TEST_RIG_JOINTS; j += 2) {
+		inPlace[j].GetPositionTrack().SetInterpolation(Interpolation::Constant);
+	}
+	inPlace.RecalculateInterpolation();
+	TEST_CHECK(!inPlace.HasUniformInterpolation());
+
+	const Clip* clips[3] = { &scalar, &simd, &inPlace };
+	for (int c = 0; c < 3; ++c) {
+		for (int raw = 0; raw < 2; ++raw) {
+			std::vector<Transform> expected = ClipThreadHelpers::SampleFrames(*clips[c], rest, raw != 0);
+			TEST_CHECK(ClipThreadHelpers::SampleOnThreads(*clips[c], rest, raw != 0, expected) == 0);
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#include "Tests.h"
+#include "TestRig.h"
+
+// A -1 joint id, as a channel without a target node would give
+#define CLIP_TRACK_INVALID_JOINT 0xFFFFFFFFu
+
+void TestInvalidJointIds() {
+	Clip clip = MakeTestClip(4, Interpolation::Linear);
+	TEST_CHECK(clip.GetTrackIndex(2) == 2);
+
+	// Stays out of the joint table, the other tracks are still found
+	TransformTrack& invalid = clip[CLIP_TRACK_INVALID_JOINT];
+	invalid.GetPositionTrack() = clip[1].GetPositionTrack();
+	TEST_CHECK(clip.Size() == 5);
+	TEST_CHECK(clip.GetTrackIndex(CLIP_TRACK_INVALID_JOINT) == 4);
+	TEST_CHECK(clip.GetTrackIndex(2) == 2);
+	TEST_CHECK(&clip[CLIP_TRACK_INVALID_JOINT] == &clip[CLIP_TRACK_INVALID_JOINT]);
+	TEST_CHECK(clip.Size() == 5);
+
+	// Sampling skips the track rather than writing past the pose
+	clip.RecalculateInterpolation();
+	Pose pose = MakeTestRig(4, true);
+	Pose expected = pose;
+	MakeTestClip(4, Interpolation::Linear).Sample(expected, 0.5f);
+	clip.Sample(pose, 0.5f);
+	TEST_CHECK(PoseDifference(pose, expected) == 0.0f);
+
+	clip.SortTracks();
+	TEST_CHECK(clip.GetTrackIndex(CLIP_TRACK_INVALID_JOINT) == 4);
+	TEST_CHECK(clip.GetTrackIndex(0) == 0);
+	clip.SetIdAtIndex(4, 7);
+	TEST_CHECK(clip.GetTrackIndex(CLIP_TRACK_INVALID_JOINT) == -1);
+	TEST_CHECK(clip.GetTrackIndex(7) == 4);
+	clip.SetIdAtIndex(4, CLIP_TRACK_INVALID_JOINT);
+	TEST_CHECK(clip.GetTrackIndex(7) == -1);
+	TEST_CHECK(clip.GetTrackIndex(CLIP_TRACK_INVALID_JOINT) == 4);
+}
@@ -0,0 +1,137 @@
+#include "Tests.h"
+#include "TestRig.h"
+#include "Blending.h"
+#include "FrameArena.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+// Frames run before counting starts, so every buffer has grown to size
+#define ALLOCATION_WARM_UP_FRAMES 8
+#define ALLOCATION_TEST_FRAMES 1000
+
+// Every heap allocation in the test program goes through these
+namespace PoseAllocationHelpers {
+	std::atomic<unsigned int> gAllocations(0);
+
+	void* Allocate(std::size_t size) {
+		++gAllocations;
+		void* result = std::malloc(size != 0 ? size : 1);
+		if (result == 0) {
+			throw std::bad_alloc();
+		}
+		return result;
+	}
+}
+
+void* operator new(std::size_t size) {
+	return PoseAllocationHelpers::Allocate(size);
+}
+
+void* operator new[](std::size_t size) {
+	return PoseAllocationHelpers::Allocate(size);
+}
+
+// std::stable_sort and friends ask for scratch memory this way
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	++PoseAllocationHelpers::gAllocations;
+	return std::malloc(size != 0 ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	++PoseAllocationHelpers::gAllocations;
+	return std::malloc(size != 0 ? size : 1);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+
+// One frame of two characters: copy the rest pose, sample, blend the
+// upper body of one onto the other and build the palettes
+void TestSteadyStateAllocations() {
+	Pose rest = MakeTestRig(TEST_RIG_JOINTS, true);
+	Clip linear = MakeTestClip(TEST_RIG_JOINTS, Interpolation::Linear);
+	Clip cubic = MakeTestClip(TEST_RIG_JOINTS, Interpolation::Cubic);
+	linear.SetSamplingBackend(SamplingBackend::Simd);
+	std::vector<float> mask;
+	BuildBlendMask(rest, 1, mask);
+
+	Pose a, b, blended;
+	ClipCursor cursorA, cursorB;
+	std::vector<mat4> palette;
+	FrameArena& arena = FrameArena::GetThreadArena();
+	unsigned int allocations = 0;
+	unsigned int overflows = 0;
+	for (unsigned int frame = 0; frame < ALLOCATION_WARM_UP_FRAMES + ALLOCATION_TEST_FRAMES; ++frame) {
+		if (frame == ALLOCATION_WARM_UP_FRAMES) {
+			allocations = PoseAllocationHelpers::gAllocations;
+		}
+		float time = (float)frame / 60.0f;
+		a = rest;
+		b = rest;
+		linear.Sample(a, time, cursorA);
+		cubic.Sample(b, time * 1.5f, cursorB);
+		Blend(blended, a, b, 0.5f, -1);
+		a.GetMatrixPalette(palette);
+		Blend(blended, a, b, 0.75f, mask);
+		blended.GetMatrixPalette(palette);
+		arena.Reset();
+		overflows += arena.GetLastFrameStats().mOverflowAllocations;
+	}
+	allocations = PoseAllocationHelpers::gAllocations - allocations;
+	TEST_CHECK(allocations == 0);
+	TEST_CHECK(overflows == 0);
+	if (allocations != 0) {
+		std::printf("  %u allocations in %d frames\n", allocations, ALLOCATION_TEST_FRAMES);
+	}
+}
+
+void TestMovedFromPose() {
+	Pose rest = MakeTestRig(TEST_RIG_JOINTS, true);
+	Pose source = rest;
+	Pose moved(std::move(source));
+	TEST_CHECK(source.Size() == 0);
+	TEST_CHECK(moved == rest);
+
+	Pose assigned;
+	assigned = std::move(moved);
+	TEST_CHECK(moved.Size() == 0);
+	TEST_CHECK(assigned == rest);
+	TEST_CHECK(moved.GetGlobalTransforms().size() == 0);
+
+	// Still usable, and growing one empty pose leaves the other alone
+	moved.Resize(3);
+	moved.SetParent(0, -1);
+	moved.SetParent(1, 0);
+	moved.SetParent(2, 1);
+	moved.SetLocalTransform(1, Transform(vec3(0, 1, 0), Quaternion(), vec3(1, 1, 1)));
+	moved.SetLocalTransform(2, Transform(vec3(0, 2, 0), Quaternion(), vec3(1, 1, 1)));
+	TEST_CHECK(source.Size() == 0);
+	TEST_CHECK(moved.Size() == 3);
+	TEST_CHECK(moved.GetGlobalTransform(2).position.y == 3.0f);
+	source = rest;
+	TEST_CHECK(source == rest);
+	TEST_CHECK(source.SharesHierarchy(rest));
+}
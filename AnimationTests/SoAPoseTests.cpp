@@ -0,0 +1,98 @@
+#include "Tests.h"
+#include "TestRig.h"
+#include "SoAPose.h"
+#include <cmath>
+
+#define SOA_POSE_BENCHMARK_FRAMES 20000
+
+namespace SoAPoseTestHelpers {
+	// Runs the scalar CombineJoint on every joint, the reference for the
+	// blocks UpdateGlobalTransforms combines with SSE
+	class ScalarSoAPose : public SoAPose {
+	public:
+		ScalarSoAPose(Pose& pose) : SoAPose(pose) { }
+
+		void UpdateGlobalTransformsScalar() {
+			unsigned int padded = (unsigned int)mParents.size();
+			for (unsigned int i = 0; i < padded; ++i) {
+				CombineJoint(i);
+			}
+		}
+	};
+
+	float MatrixDifference(const mat4& a, const mat4& b) {
+		float result = 0.0f;
+		for (unsigned int i = 0; i < 16; ++i) {
+			result = fmaxf(result, fabsf(a.v[i] - b.v[i]));
+		}
+		return result;
+	}
+
+	// The rig sampled part way into the test clip, so there is non
+	// uniform scale down the hierarchy
+	Pose MakeAnimatedPose(unsigned int numJoints, bool parentsFirst) {
+		Pose result = MakeTestRig(numJoints, parentsFirst);
+		Clip clip = MakeTestClip(numJoints, Interpolation::Linear);
+		clip.Sample(result, 0.73f);
+		return result;
+	}
+}
+
+void TestSoAPosePalette() {
+	// Sizes that leave a partial block, with and without shuffled joints
+	unsigned int sizes[4] = { 3, 37, TEST_RIG_JOINTS, TEST_RIG_JOINTS + 3 };
+	for (unsigned int s = 0; s < 4; ++s) {
+		for (int ordered = 0; ordered < 2; ++ordered) {
+			Pose pose = SoAPoseTestHelpers::MakeAnimatedPose(sizes[s], ordered != 0);
+			unsigned int size = pose.Size();
+
+			SoAPose soa(pose);
+			SoAPoseTestHelpers::ScalarSoAPose scalar(pose);
+			std::vector<mat4> palette;
+			soa.GetMatrixPalette(palette);
+			scalar.UpdateGlobalTransformsScalar();
+			TEST_CHECK(palette.size() == size);
+
+			std::vector<mat4> expected;
+			pose.GetMatrixPalette(expected);
+			float globalError = 0.0f;
+			float paletteError = 0.0f;
+			for (unsigned int i = 0; i < size && i < palette.size(); ++i) {
+				globalError = fmaxf(globalError, TransformDifference(
+					soa.GetGlobalTransform(i), scalar.GetGlobalTransform(i)));
+				paletteError = fmaxf(paletteError, SoAPoseTestHelpers::MatrixDifference(
+					palette[i], expected[i]));
+			}
+			TEST_CHECK(globalError < 1e-6f);
+			TEST_CHECK(paletteError < 1e-6f);
+			if (globalError >= 1e-6f || paletteError >= 1e-6f) {
+				std::printf("  %u joints, %s: globals off by %g, palette by %g\n", size,
+					ordered ? "ordered" : "shuffled", globalError, paletteError);
+			}
+		}
+	}
+}
+
+void BenchmarkSoAPosePalette() {
+	std::printf("Matrix palette, %d joints\n", TEST_RIG_JOINTS);
+	for (int ordered = 1; ordered >= 0; --ordered) {
+		Pose pose = SoAPoseTestHelpers::MakeAnimatedPose(TEST_RIG_JOINTS, ordered != 0);
+		SoAPose soa(pose);
+		std::vector<mat4> palette;
+
+		double time = MeasureMicroseconds(SOA_POSE_BENCHMARK_FRAMES, [&](unsigned int) {
+			pose.RefreshGlobalTransforms();
+			pose.GetMatrixPalette(palette);
+		});
+		std::printf("  %-8s %-20s %8.3f us\n", ordered ? "ordered" : "shuffled", "Pose", time);
+		time = MeasureMicroseconds(SOA_POSE_BENCHMARK_FRAMES, [&](unsigned int) {
+			soa.GetMatrixPalette(palette);
+		});
+		std::printf("  %-8s %-20s %8.3f us\n", ordered ? "ordered" : "shuffled", "SoAPose", time);
+		time = MeasureMicroseconds(SOA_POSE_BENCHMARK_FRAMES, [&](unsigned int) {
+			soa.Set(pose);
+			soa.GetMatrixPalette(palette);
+		});
+		std::printf("  %-8s %-20s %8.3f us\n", ordered ? "ordered" : "shuffled", "SoAPose from Pose", time);
+	}
+}
@@ -0,0 +1,25 @@
+#include "Tests.h"
+#include "TestRig.h"
+#include <cstring>
+
+// Runs every test, pass "bench" to run the benchmarks as well. Returns
+// the number of failed checks so a build step can use it.
+int main(int argc, const char** argv) {
+	bool benchmarks = argc > 1 && std::strcmp(argv[1], "bench") == 0;
+
+	TestConcurrentSampling();
+	TestOffsetStartPlayback();
+	TestInvalidJointIds();
+	TestSoAPosePalette();
+	TestSteadyStateAllocations();
+	TestMovedFromPose();
+
+	if (benchmarks) {
+		BenchmarkSamplingBackends();
+		BenchmarkInPlaceSampling();
+		BenchmarkSoAPosePalette();
+	}
+
+	std::printf("%d failed checks\n", gTestFailures);
+	return gTestFailures;
+}
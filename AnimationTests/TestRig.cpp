@@ -0,0 +1,118 @@
+#include "TestRig.h"
+#include <cmath>
+
+int gTestFailures = 0;
+
+namespace TestRigHelpers {
+	// Same numbers on every platform, unlike rand
+	unsigned int NextRandom(unsigned int& state) {
+		state = state * 1664525u + 1013904223u;
+		return state >> 8;
+	}
+
+	template<typename T, int N>
+	void SetKey(Track<T, N>& track, unsigned int index, float time, const float* value) {
+		Frame<N> frame;
+		frame.mTime = time;
+		for (int i = 0; i < N; ++i) {
+			frame.mValue[i] = value[i];
+			frame.mIn[i] = 0.0f;
+			frame.mOut[i] = 0.0f;
+		}
+		track.SetFrame(index, frame);
+	}
+}
+
+Pose MakeTestRig(unsigned int numJoints, bool parentsFirst) {
+	// Joint i of the ordered rig ends up at order[i]
+	std::vector<unsigned int> order(numJoints);
+	for (unsigned int i = 0; i < numJoints; ++i) {
+		order[i] = i;
+	}
+	if (!parentsFirst) {
+		unsigned int state = 7;
+		for (unsigned int i = numJoints; i > 1; --i) {
+			unsigned int j = TestRigHelpers::NextRandom(state) % i;
+			unsigned int swap = order[i - 1];
+			order[i - 1] = order[j];
+			order[j] = swap;
+		}
+	}
+
+	Pose result(numJoints);
+	for (unsigned int i = 0; i < numJoints; ++i) {
+		// Three children per joint, so there are chains and branches
+		int parent = i == 0 ? -1 : (int)order[(i - 1) / 3];
+		result.SetParent(order[i], parent);
+		float f = (float)i;
+		Transform local(vec3(0.1f * f, 1.0f, 0.05f * f),
+			AngleAxis(0.1f * f, Normalised(vec3(1.0f, f, 2.0f))), vec3(1.0f, 1.0f, 1.0f));
+		result.SetLocalTransform(order[i], local);
+	}
+	return result;
+}
+
+Clip MakeTestClip(unsigned int numJoints, Interpolation interpolation) {
+	Clip result;
+	result.SetName("Test clip");
+	unsigned int numKeys = (unsigned int)(TEST_RIG_DURATION * TEST_RIG_KEYS_PER_SECOND) + 1;
+	for (unsigned int j = 0; j < numJoints; ++j) {
+		TransformTrack& track = result[j];
+		float phase = 0.37f * (float)j;
+		// Every fourth joint rotates on its own, slower key rate
+		unsigned int rotationKeys = j % 4 == 3 ? numKeys / 2 + 1 : numKeys;
+
+		track.GetPositionTrack().SetInterpolation(interpolation);
+		track.GetPositionTrack().Resize(numKeys);
+		track.GetRotationTrack().SetInterpolation(interpolation);
+		track.GetRotationTrack().Resize(rotationKeys);
+		if (j % 5 == 0) {
+			track.GetScaleTrack().SetInterpolation(interpolation);
+			track.GetScaleTrack().Resize(numKeys);
+		}
+
+		for (unsigned int k = 0; k < numKeys; ++k) {
+			float time = (float)k / TEST_RIG_KEYS_PER_SECOND;
+			float position[3] = { sinf(time * 3.0f + phase), 1.0f, cosf(time * 2.0f + phase) };
+			TestRigHelpers::SetKey(track.GetPositionTrack(), k, time, position);
+			if (j % 5 == 0) {
+				float scale[3] = { 1.0f + 0.5f * sinf(time * 4.0f + phase), 1.0f, 0.75f };
+				TestRigHelpers::SetKey(track.GetScaleTrack(), k, time, scale);
+			}
+		}
+		for (unsigned int k = 0; k < rotationKeys; ++k) {
+			float time = TEST_RIG_DURATION * (float)k / (float)(rotationKeys - 1);
+			Quaternion rotation = AngleAxis(sinf(time * 2.5f + phase) * 1.5f,
+				Normalised(vec3(1.0f, 0.5f * phase, 0.25f)));
+			TestRigHelpers::SetKey(track.GetRotationTrack(), k, time, rotation.v);
+		}
+	}
+	result.RecalculateDuration();
+	result.UpdateSharedTimelines();
+	result.RecalculateInterpolation();
+	return result;
+}
+
+float TransformDifference(const Transform& a, const Transform& b) {
+	const float* left[3] = { a.position.v, a.rotation.v, a.scale.v };
+	const float* right[3] = { b.position.v, b.rotation.v, b.scale.v };
+	const int sizes[3] = { 3, 4, 3 };
+	float result = 0.0f;
+	for (int i = 0; i < 3; ++i) {
+		for (int k = 0; k < sizes[i]; ++k) {
+			result = fmaxf(result, fabsf(left[i][k] - right[i][k]));
+		}
+	}
+	return result;
+}
+
+float PoseDifference(Pose& a, Pose& b) {
+	if (a.Size() != b.Size()) {
+		return INFINITY;
+	}
+	float result = 0.0f;
+	for (unsigned int i = 0; i < a.Size(); ++i) {
+		result = fmaxf(result, TransformDifference(a.GetLocalTransform(i), b.GetLocalTransform(i)));
+	}
+	return result;
+}
@@ -0,0 +1,44 @@
+#ifndef _H_TESTRIG_
+#define _H_TESTRIG_
+
+#include "Pose.h"
+#include "Clip.h"
+#include <chrono>
+#include <cstdio>
+
+// Joint count of the rig the benchmarks run on
+#define TEST_RIG_JOINTS 100
+// Key rate and length of the generated clips
+#define TEST_RIG_KEYS_PER_SECOND 30.0f
+#define TEST_RIG_DURATION 2.0f
+
+extern int gTestFailures;
+
+#define TEST_CHECK(condition) do { if (!(condition)) { \
+	std::printf("FAILED %s:%d %s\n", __FILE__, __LINE__, #condition); \
+	++gTestFailures; } } while (0)
+
+// A branching hierarchy with numJoints joints. With parentsFirst false
+// the joints are shuffled so some children come before their parents.
+Pose MakeTestRig(unsigned int numJoints, bool parentsFirst);
+// A looping clip that moves every joint of the rig, every channel uses
+// interpolation. Scale is non uniform on some joints.
+Clip MakeTestClip(unsigned int numJoints, Interpolation interpolation);
+// Largest difference between any component of the two transforms
+float TransformDifference(const Transform& a, const Transform& b);
+float PoseDifference(Pose& a, Pose& b);
+
+// Average microseconds one call of fn takes over iterations calls
+template<typename F>
+double MeasureMicroseconds(unsigned int iterations, F fn) {
+	std::chrono::high_resolution_clock::time_point start =
+		std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < iterations; ++i) {
+		fn(i);
+	}
+	std::chrono::duration<double, std::micro> elapsed =
+		std::chrono::high_resolution_clock::now() - start;
+	return elapsed.count() / (double)iterations;
+}
+
+#endif // !_H_TESTRIG_
@@ -0,0 +1,17 @@
+#ifndef _H_TESTS_
+#define _H_TESTS_
+
+// Each test prints what failed and counts it in gTestFailures
+void TestConcurrentSampling();
+void TestOffsetStartPlayback();
+void TestInvalidJointIds();
+void TestSoAPosePalette();
+void TestSteadyStateAllocations();
+void TestMovedFromPose();
+
+// Benchmarks print their timings, run them from a release build
+void BenchmarkSamplingBackends();
+void BenchmarkInPlaceSampling();
+void BenchmarkSoAPosePalette();
+
+#endif // !_H_TESTS_